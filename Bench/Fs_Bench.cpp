@@ -0,0 +1,446 @@
+#include "../FsLib.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// fs_bench [google benchmark flags] [--fs_dirs=/dev/shm,/var/tmp] [--fs_max_size=4G]
+//          [--fs_max_fanout=65536] [--fs_max_threads=8]
+//
+// Every benchmark is registered once per --fs_dirs entry so tmpfs and disk runs
+// sit side by side. bytes_per_second is the MB/s figure, items_per_second the
+// ops/s one (entries/s for the directory benchmarks), syscr / syscw the read and
+// write class syscalls per op from /proc/self/io (0 where it is not available).
+
+namespace
+{
+    struct bench_config
+    {
+        std::vector<fs::path>   Dirs;
+        uint64_t                MaxSize     = 64ull << 20;
+        int64_t                 MaxFanout   = 4096;
+        int                     MaxThreads  = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    };
+
+    bench_config config;
+
+    uint64_t parseSize(const std::string &text)
+    {
+        std::size_t used = 0;
+        uint64_t value = std::stoull(text, &used);
+        switch (used < text.size() ? text[used] : 0)
+        {
+        case 'G': case 'g': value <<= 10; [[fallthrough]];
+        case 'M': case 'm': value <<= 10; [[fallthrough]];
+        case 'K': case 'k': value <<= 10; break;
+        default: break;
+        }
+        return value;
+    }
+
+    // Process wide counters, sampled by thread 0 only
+    struct io_counters
+    {
+        uint64_t Reads  = 0;
+        uint64_t Writes = 0;
+    };
+
+    io_counters readCounters()
+    {
+        io_counters result;
+        std::ifstream input("/proc/self/io");
+        std::string key;
+        uint64_t value = 0;
+        while (input >> key >> value)
+        {
+            if (key == "syscr:")
+            {
+                result.Reads = value;
+            }
+            else if (key == "syscw:")
+            {
+                result.Writes = value;
+            }
+        }
+        return result;
+    }
+
+    // Syscalls spent by readCounters itself, taken off every sample
+    io_counters sampleCost()
+    {
+        const auto first  = readCounters();
+        const auto second = readCounters();
+        return { second.Reads - first.Reads, second.Writes - first.Writes };
+    }
+
+    class SyscallMeter
+    {
+    public:
+        explicit SyscallMeter(const benchmark::State &state)
+            : m_active(state.thread_index() == 0)
+        {
+        }
+
+        void start()
+        {
+            if (m_active)
+            {
+                m_begin = readCounters();
+            }
+        }
+
+        void stop()
+        {
+            if (!m_active)
+            {
+                return;
+            }
+            static const io_counters cost = sampleCost();
+            const auto end = readCounters();
+            m_reads  += end.Reads  - m_begin.Reads  - std::min(end.Reads  - m_begin.Reads,  cost.Reads);
+            m_writes += end.Writes - m_begin.Writes - std::min(end.Writes - m_begin.Writes, cost.Writes);
+        }
+
+        // Counters are summed over threads and divided by the total iteration count
+        void report(benchmark::State &state) const
+        {
+            state.counters["syscr"] = benchmark::Counter(static_cast<double>(m_reads),  benchmark::Counter::kAvgIterations);
+            state.counters["syscw"] = benchmark::Counter(static_cast<double>(m_writes), benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        bool        m_active;
+        io_counters m_begin;
+        uint64_t    m_reads     = 0;
+        uint64_t    m_writes    = 0;
+    };
+
+    fs::path threadFile(const fs::path &dir, const char *name, const benchmark::State &state)
+    {
+        return dir / (std::string(name) + "." + std::to_string(state.thread_index()));
+    }
+
+    void fillDir(const fs::path &dir, const int64_t count)
+    {
+        fs::createDirectory(dir);
+        for (int64_t i = 0; i < count; ++i)
+        {
+            fs::writeFile(dir / ("f" + std::to_string(i)), std::string());
+        }
+    }
+
+    void benchReadFile(benchmark::State &state, const fs::path &dir)
+    {
+        const auto size = static_cast<std::size_t>(state.range(0));
+        const auto file = threadFile(dir, "read", state);
+        fs::writeFile(file, std::string(size, 'r'), true);
+        std::vector<uint8_t> data;
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            if (!fs::readFile(file, data))
+            {
+                state.SkipWithError("readFile failed");
+                break;
+            }
+            benchmark::DoNotOptimize(data.data());
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        fs::removeFile(file);
+    }
+
+    void benchWriteFile(benchmark::State &state, const fs::path &dir)
+    {
+        const auto size = static_cast<std::size_t>(state.range(0));
+        const auto file = threadFile(dir, "write", state);
+        const std::string data(size, 'w');
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            if (!fs::writeFile(file, data, true))
+            {
+                state.SkipWithError("writeFile failed");
+                break;
+            }
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        fs::removeFile(file);
+    }
+
+    void benchAppendFile(benchmark::State &state, const fs::path &dir)
+    {
+        constexpr uint64_t restart_at = 256ull << 20;
+        const auto size = static_cast<std::size_t>(state.range(0));
+        const auto file = threadFile(dir, "append", state);
+        const std::string data(size, 'a');
+        uint64_t length = 0;
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            if (!fs::appendFile(file, data))
+            {
+                state.SkipWithError("appendFile failed");
+                break;
+            }
+            length += size;
+            if (length >= restart_at)
+            {
+                // Keeps long runs from filling a small tmpfs
+                state.PauseTiming();
+                fs::removeFile(file);
+                length = 0;
+                state.ResumeTiming();
+            }
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        fs::removeFile(file);
+    }
+
+    void benchCopyFile(benchmark::State &state, const fs::path &dir)
+    {
+        const auto size = static_cast<std::size_t>(state.range(0));
+        const auto from = threadFile(dir, "copy_from", state);
+        const auto to   = threadFile(dir, "copy_to", state);
+        fs::writeFile(from, std::string(size, 'c'), true);
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            if (!fs::copyFile(from, to))
+            {
+                state.SkipWithError("copyFile failed");
+                break;
+            }
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        fs::removeFile(from);
+        fs::removeFile(to);
+    }
+
+    void benchEnumDir(benchmark::State &state, const fs::path &dir)
+    {
+        const int64_t fanout = state.range(0);
+        const auto root = threadFile(dir, "enum", state);
+        fillDir(root, fanout);
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            const auto entries = fs::enumDir(root);
+            if (static_cast<int64_t>(entries.size()) != fanout)
+            {
+                state.SkipWithError("enumDir missed entries");
+                break;
+            }
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetItemsProcessed(state.iterations() * fanout);
+        fs::removeDir(root);
+    }
+
+    void benchGetMetadata(benchmark::State &state, const fs::path &dir)
+    {
+        const int64_t fanout = state.range(0);
+        const auto root = threadFile(dir, "stat", state);
+        fillDir(root, fanout);
+        std::vector<fs::path> paths;
+        for (int64_t i = 0; i < fanout; ++i)
+        {
+            paths.push_back(root / ("f" + std::to_string(i)));
+        }
+        fs::metadata result;
+        SyscallMeter meter(state);
+        meter.start();
+        for (auto _ : state)
+        {
+            for (const auto &it : paths)
+            {
+                if (!fs::getMetadata(it, result))
+                {
+                    state.SkipWithError("getMetadata failed");
+                    break;
+                }
+            }
+        }
+        meter.stop();
+        meter.report(state);
+        state.SetItemsProcessed(state.iterations() * fanout);
+        fs::removeDir(root);
+    }
+
+    void benchCreateDirectory(benchmark::State &state, const fs::path &dir)
+    {
+        const int64_t fanout = state.range(0);
+        const auto root = threadFile(dir, "mkdir", state);
+        SyscallMeter meter(state);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            fs::removeDir(root);
+            fs::createDirectory(root);
+            state.ResumeTiming();
+            meter.start();
+            for (int64_t i = 0; i < fanout; ++i)
+            {
+                if (!fs::createDirectory(root / ("d" + std::to_string(i)), false))
+                {
+                    state.SkipWithError("createDirectory failed");
+                    break;
+                }
+            }
+            meter.stop();
+        }
+        meter.report(state);
+        state.SetItemsProcessed(state.iterations() * fanout);
+        fs::removeDir(root);
+    }
+
+    void benchRemoveDir(benchmark::State &state, const fs::path &dir)
+    {
+        const int64_t fanout = state.range(0);
+        const auto root = threadFile(dir, "rmdir", state);
+        SyscallMeter meter(state);
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            fillDir(root, fanout);
+            state.ResumeTiming();
+            meter.start();
+            if (!fs::removeDir(root))
+            {
+                state.SkipWithError("removeDir failed");
+                break;
+            }
+            meter.stop();
+        }
+        meter.report(state);
+        state.SetItemsProcessed(state.iterations() * fanout);
+    }
+
+    using bench_function = void (*)(benchmark::State &, const fs::path &);
+
+    // Named after the --fs_dirs entry, not the scratch dir, so names match between runs
+    benchmark::internal::Benchmark *registerBench(const char *name, const bench_function function, const fs::path &dir)
+    {
+        const auto label = std::string(name) + "@" + dir.parent_path().string();
+        return benchmark::RegisterBenchmark(label.c_str(), function, dir)->UseRealTime();
+    }
+
+    // Sizes from 1 KB up in *16 steps, multi-GB when --fs_max_size allows it
+    void registerSized(const char *name, const bench_function function, const fs::path &dir)
+    {
+        auto *bench = registerBench(name, function, dir);
+        for (uint64_t size = 1ull << 10; size <= config.MaxSize; size <<= 4)
+        {
+            bench->Arg(static_cast<int64_t>(size));
+        }
+        bench->ThreadRange(1, config.MaxThreads);
+    }
+
+    // Entries per directory, 16 up to --fs_max_fanout
+    benchmark::internal::Benchmark *registerFanout(const char *name, const bench_function function, const fs::path &dir)
+    {
+        return registerBench(name, function, dir)->RangeMultiplier(16)->Range(16, config.MaxFanout);
+    }
+
+    void parseArguments(int argc, char **argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            auto value = [&](const char *flag) -> const char *
+            {
+                const auto length = std::strlen(flag);
+                return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+            };
+            if (const char *dirs = value("--fs_dirs="))
+            {
+                std::stringstream list(dirs);
+                std::string dir;
+                while (std::getline(list, dir, ','))
+                {
+                    if (!dir.empty())
+                    {
+                        config.Dirs.emplace_back(dir);
+                    }
+                }
+            }
+            else if (const char *size = value("--fs_max_size="))
+            {
+                config.MaxSize = parseSize(size);
+            }
+            else if (const char *fanout = value("--fs_max_fanout="))
+            {
+                config.MaxFanout = std::max<int64_t>(16, std::stoll(fanout));
+            }
+            else if (const char *threads = value("--fs_max_threads="))
+            {
+                config.MaxThreads = std::max(1, std::stoi(threads));
+            }
+            else
+            {
+                std::fprintf(stderr, "fs_bench: unknown argument %s\n", argv[i]);
+                std::exit(1);
+            }
+        }
+        if (config.Dirs.empty())
+        {
+            config.Dirs.push_back(std::filesystem::temp_directory_path());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    parseArguments(argc, argv);
+
+    // Scratch trees live in a directory of their own under every --fs_dirs entry
+    std::vector<fs::path> scratch;
+    for (const auto &it : config.Dirs)
+    {
+        auto dir = it / ("fs_bench." + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()));
+        if (!fs::createDirectory(dir, false))
+        {
+            std::fprintf(stderr, "fs_bench: cannot create %s\n", dir.c_str());
+            return 1;
+        }
+        scratch.push_back(dir);
+        registerSized("readFile", benchReadFile, dir);
+        registerSized("writeFile", benchWriteFile, dir);
+        registerSized("copyFile", benchCopyFile, dir);
+        registerBench("appendFile", benchAppendFile, dir)->Arg(64)->Arg(4 << 10)->Arg(64 << 10)->ThreadRange(1, config.MaxThreads);
+        registerFanout("enumDir", benchEnumDir, dir)->ThreadRange(1, config.MaxThreads);
+        registerFanout("getMetadata", benchGetMetadata, dir)->ThreadRange(1, config.MaxThreads);
+        registerFanout("createDirectory", benchCreateDirectory, dir);
+        registerFanout("removeDir", benchRemoveDir, dir);
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    for (const auto &it : scratch)
+    {
+        fs::removeDir(it);
+    }
+    return 0;
+}
@@ -13,16 +13,30 @@
 #endif
 
 #include <algorithm>
+#include <array>
 #include <string>
 #include <list>
 #include <vector>
 #include <regex>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <unordered_set>
 #if defined IS_CPP_17G
 #include <filesystem>
 #include <string_view>
 #else
 #error Unsupported.
 #endif
+#if defined IS_CPP_20G
+#include <span>
+#endif
+#if !defined PLATFORM_WIN
+#include <sys/stat.h>
+#endif
 
 #if defined FS_USE_WINAPI
 #define FS_APENDIX winapi
@@ -103,12 +117,315 @@
         LIB_EXPORT bool                         isDirectory(const fs::path &Path);      \
         LIB_EXPORT bool                         isExist(const fs::path &Path);          \
         LIB_EXPORT bool                         createDirectory(const fs::path &Path, const bool recirsive = true); \
-        LIB_EXPORT const std::list<fs::path>    enumDir(const fs::path &Path, const std::string &regFilter = {});
+        LIB_EXPORT const std::list<fs::path>    enumDir(const fs::path &Path, const std::string &regFilter = {}); \
+        LIB_EXPORT bool                         getMetadata(const fs::path &Path, fs::metadata &result, const uint32_t fields = fs::metadata_field::basic, const bool followLinks = true);
+
+// Extensions without a winapi counterpart, resolved straight to the posix backend.
+#if !defined PLATFORM_WIN
+#define DEFINE_POSIX_EXT_FS() \
+        LIB_EXPORT fs::MappedFile               mapFile(const fs::path &filePath, const fs::map_options &options = {});   \
+        LIB_EXPORT bool                         readFile(const fs::path &filePath, fs::ReadBuffer &data, const bool silent = false); \
+        LIB_EXPORT bool                         readFile(const fs::path &filePath, void *data, const std::size_t capacity, std::size_t &readBytes, const bool silent = false); \
+        LIB_EXPORT bool                         readFile(const fs::path &filePath, fs::ReadBuffer &data, const fs::checksum &expected, const bool silent = false); \
+        LIB_EXPORT bool                         writeFile(const fs::path &filePath, std::string_view data, fs::checksum &result, const bool force = false); \
+        LIB_EXPORT bool                         writeFile(const fs::path &filePath, const std::vector<uint8_t> &data, fs::checksum &result, const bool force = false); \
+        LIB_EXPORT bool                         hashFile(const fs::path &filePath, uint64_t &digest, const fs::hash_options &options = {}); \
+        LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data, const bool silent = false); \
+        LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes, const bool silent = false); \
+        LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, std::string_view data); \
+        LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, const std::vector<uint8_t> &data); \
+        LIB_EXPORT bool                         readFileCompressed(const fs::path &filePath, fs::ReadBuffer &data, const unsigned threads = 0); \
+        LIB_EXPORT bool                         readRangeCompressed(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data); \
+        LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         removeDir(const fs::path &Path, const fs::remove_options &options); \
+        LIB_EXPORT bool                         walk(const fs::path &Path, const fs::walk_visitor &visitor, const fs::walk_options &options = {}); \
+        LIB_EXPORT const std::list<fs::path>    enumDir(const fs::path &Path, const fs::NameFilter &filter); \
+        LIB_EXPORT bool                         copyFile(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options = {}); \
+        LIB_EXPORT bool                         copyTree(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options = {}); \
+        LIB_EXPORT bool                         diffTrees(const fs::path &oldPath, const fs::path &newPath, std::vector<fs::tree_change> &changes, const fs::compare_options &options = {}); \
+        LIB_EXPORT bool                         findDuplicates(const fs::path &Path, std::vector<std::vector<fs::path>> &groups, const fs::compare_options &options = {}); \
+        LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::atomic_write_options &options = {}); \
+        LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::string_view data, const fs::atomic_write_options &options = {}); \
+        LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::wstring_view data, const fs::atomic_write_options &options = {}); \
+        LIB_EXPORT bool                         writeFilesAtomic(const std::vector<fs::atomic_write> &files, const fs::atomic_write_options &options = {}); \
+        LIB_EXPORT bool                         getMetadata(const std::vector<fs::path> &paths, std::vector<fs::metadata> &results, const uint32_t fields = fs::metadata_field::basic, const unsigned threads = 0); \
+        LIB_EXPORT std::vector<fs::io_result>   readFiles(const std::vector<fs::path> &paths, const fs::batch_options &options = {}); \
+        LIB_EXPORT std::vector<fs::io_result>   writeFiles(const std::vector<fs::io_request> &requests, const fs::batch_options &options = {}); \
+        LIB_EXPORT bool                         createDirectories(const std::vector<fs::path> &paths, const fs::mkdir_options &options = {}); \
+        LIB_EXPORT void                         setPathCache(const fs::path_cache_options &options); \
+        LIB_EXPORT void                         invalidatePathCache(const fs::path &Path = {}); \
+        DEFINE_POSIX_EXT_FS_20()
+#if defined IS_CPP_20G
+#define DEFINE_POSIX_EXT_FS_20() \
+        LIB_EXPORT bool                         readFile(const fs::path &filePath, std::span<std::byte> data, std::size_t &readBytes, const bool silent = false); \
+        LIB_EXPORT bool                         writeFile(const fs::path &filePath, std::span<const std::byte> data, fs::checksum &result, const bool force = false); \
+        LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, std::span<std::byte> data, std::size_t &readBytes, const bool silent = false); \
+        LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, std::span<const std::byte> data); \
+        LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options = {}); \
+        LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::span<const std::byte> data, const fs::atomic_write_options &options = {});
+#else
+#define DEFINE_POSIX_EXT_FS_20()
+#endif
+#else
+#define DEFINE_POSIX_EXT_FS()
+#endif
 
 
 namespace fs
 {
     using path = std::filesystem::path;
+
+    // Entry name matcher compiled once, cheap to copy and safe to share between threads.
+    // Plain globs are reduced to exact / prefix / suffix / substring compares,
+    // the rest goes through a precompiled glob or a std::regex (full match).
+    class LIB_EXPORT NameFilter
+    {
+    public:
+        enum class kind : uint8_t
+        {
+            any,
+            none,       // invalid regex, matches nothing
+            exact,
+            prefix,
+            suffix,
+            contains,
+            glob,
+            regex,
+        };
+
+        // Matches everything
+        NameFilter() = default;
+
+        // * ? [abc] [a-z] [!abc], no path separators involved
+        static NameFilter glob(std::string_view pattern);
+        static NameFilter regex(const std::string &pattern);
+        static NameFilter exact(std::string_view name);
+        static NameFilter prefix(std::string_view prefix);
+        static NameFilter suffix(std::string_view suffix);
+
+        bool match(std::string_view name) const;
+        kind type() const           { return m_kind; }
+        bool matchesAll() const     { return m_kind == kind::any; }
+
+    private:
+        struct Compiled;
+
+        kind                            m_kind  = kind::any;
+        std::string                     m_text;
+        std::shared_ptr<const Compiled> m_compiled;
+    };
+
+    // Growable byte storage which is never value-initialized: growing only
+    // reallocates, the bytes are left for the following read to overwrite.
+    // Keep one around (or take it from a BufferPool) to read many files without reallocating.
+    class LIB_EXPORT ReadBuffer
+    {
+    public:
+        ReadBuffer() = default;
+        explicit ReadBuffer(const std::size_t capacity)     { reserve(capacity); }
+        ReadBuffer(ReadBuffer &&other) noexcept;
+        ReadBuffer &operator=(ReadBuffer &&other) noexcept;
+        ReadBuffer(const ReadBuffer &) = delete;
+        ReadBuffer &operator=(const ReadBuffer &) = delete;
+
+        std::byte *data()                   { return m_storage.get(); }
+        const std::byte *data() const       { return m_storage.get(); }
+        std::size_t size() const            { return m_size; }
+        std::size_t capacity() const        { return m_capacity; }
+        bool empty() const                  { return m_size == 0; }
+        std::string_view view() const       { return { reinterpret_cast<const char *>(m_storage.get()), m_size }; }
+#if defined IS_CPP_20G
+        std::span<std::byte> bytes()                { return { m_storage.get(), m_size }; }
+        std::span<const std::byte> bytes() const    { return { m_storage.get(), m_size }; }
+#endif
+        // Keeps current contents
+        void reserve(const std::size_t capacity);
+        // Contents beyond the old size are unspecified until written
+        void resizeForOverwrite(const std::size_t size);
+        void clear()                        { m_size = 0; }
+        // Frees the storage
+        void release();
+
+    private:
+        std::unique_ptr<std::byte[]>    m_storage;
+        std::size_t                     m_size      = 0;
+        std::size_t                     m_capacity  = 0;
+    };
+
+    // Thread safe free list of ReadBuffers. A Lease hands its buffer back on destruction.
+    class LIB_EXPORT BufferPool
+    {
+    public:
+        class LIB_EXPORT Lease
+        {
+        public:
+            Lease() = default;
+            Lease(BufferPool *pool, ReadBuffer &&buffer) : m_pool(pool), m_buffer(std::move(buffer)) {}
+            Lease(Lease &&other) noexcept;
+            Lease &operator=(Lease &&other) noexcept;
+            Lease(const Lease &) = delete;
+            Lease &operator=(const Lease &) = delete;
+            ~Lease();
+
+            ReadBuffer &operator*()             { return m_buffer; }
+            ReadBuffer *operator->()            { return &m_buffer; }
+            const ReadBuffer &operator*() const { return m_buffer; }
+            const ReadBuffer *operator->() const{ return &m_buffer; }
+
+        private:
+            BufferPool *m_pool = nullptr;
+            ReadBuffer  m_buffer;
+        };
+
+        // Buffers above maxRetainedCapacity are freed instead of being kept
+        explicit BufferPool(const std::size_t maxBuffers = 16, const std::size_t maxRetainedCapacity = 64u << 20);
+        BufferPool(const BufferPool &) = delete;
+        BufferPool &operator=(const BufferPool &) = delete;
+
+        Lease acquire(const std::size_t capacityHint = 0);
+        void  trim();
+
+    private:
+        void  giveBack(ReadBuffer &&buffer);
+
+        std::mutex              m_lock;
+        std::vector<ReadBuffer> m_free;
+        const std::size_t       m_maxBuffers;
+        const std::size_t       m_maxRetainedCapacity;
+    };
+
+    enum class entry_type : uint8_t
+    {
+        unknown,
+        file,
+        directory,
+        symlink,
+        other,
+    };
+
+    // Bits for getMetadata, only the requested fields are queried (statx mask on linux)
+    namespace metadata_field
+    {
+        constexpr uint32_t type     = 1u << 0;
+        constexpr uint32_t mode     = 1u << 1;      // permission bits
+        constexpr uint32_t owner    = 1u << 2;      // uid / gid
+        constexpr uint32_t links    = 1u << 3;
+        constexpr uint32_t inode    = 1u << 4;      // device + inode
+        constexpr uint32_t size     = 1u << 5;
+        constexpr uint32_t atime    = 1u << 6;
+        constexpr uint32_t mtime    = 1u << 7;
+        constexpr uint32_t ctime    = 1u << 8;
+        constexpr uint32_t btime    = 1u << 9;      // creation time, not every filesystem has it
+        constexpr uint32_t basic    = type | mode | size | mtime;
+        constexpr uint32_t all      = basic | owner | links | inode | atime | ctime | btime;
+    }
+
+    // Platform neutral subset of stat / BY_HANDLE_FILE_INFORMATION.
+    // Times are nanoseconds since the unix epoch.
+    struct metadata
+    {
+        uint32_t    Valid       = 0;    // metadata_field bits actually filled in
+        entry_type  Type        = entry_type::unknown;
+        uint32_t    Mode        = 0;
+        uint32_t    Uid         = 0;
+        uint32_t    Gid         = 0;
+        uint64_t    Links       = 0;
+        uint64_t    Device      = 0;
+        uint64_t    Inode       = 0;
+        uint64_t    Size        = 0;
+        int64_t     AccessTime  = 0;
+        int64_t     ModifyTime  = 0;
+        int64_t     ChangeTime  = 0;
+        int64_t     BirthTime   = 0;
+        uint32_t    Attributes  = 0;    // FILE_ATTRIBUTE_* on windows
+    };
+
+    // What the fs:: entry points account for when the library is built with
+    // FS_INSTRUMENTATION. Without it nothing is measured and getIoStats() is empty.
+    enum class io_operation : uint8_t
+    {
+        read,
+        write,
+        append,
+        stat,               // isExist / isDirectory / getMetadata
+        expand_path,
+        remove_file,
+        remove_dir,
+        create_directory,
+        enum_dir,
+        walk,
+        map,
+        copy,
+        atomic_write,
+        batch_read,
+        batch_write,
+        hash,
+        compare,            // diffTrees / findDuplicates
+        sync,               // flush / sync of FileWriter, FileHandle and AppendLog
+        count
+    };
+
+    // Log-linear (HDR style) nanosecond buckets: exact below 8 ns, then 8 buckets
+    // per power of two, so a bucket is at most 12.5% wide. Tops out around 18 minutes.
+    struct LIB_EXPORT latency_histogram
+    {
+        static constexpr std::size_t sub_buckets    = 8;
+        static constexpr std::size_t buckets        = 38 * sub_buckets;
+
+        std::array<uint64_t, buckets> Counts {};
+
+        static std::size_t bucketOf(const uint64_t nanoseconds);
+        // Largest value falling into the bucket
+        static uint64_t upperBound(const std::size_t bucket);
+
+        uint64_t count() const;
+        // Upper bound of the bucket holding the given percentile (0..100), 0 when empty
+        uint64_t percentile(const double percent) const;
+    };
+
+    struct io_op_stats
+    {
+        uint64_t            Calls   = 0;
+        uint64_t            Bytes   = 0;    // moved by the call, 0 where it has no meaning
+        uint64_t            Errors  = 0;
+        uint64_t            TotalNs = 0;
+        latency_histogram   Latency;
+    };
+
+    struct io_stats
+    {
+        bool                                                            Enabled = false;
+        std::array<io_op_stats, static_cast<std::size_t>(io_operation::count)> Ops;
+
+        const io_op_stats &operator[](const io_operation op) const  { return Ops[static_cast<std::size_t>(op)]; }
+    };
+
+    // Handed to the trace hooks around every instrumented call. Begin may set Token
+    // to find its span again in End. Path is null for the batch calls and for
+    // calls on an open file (streams, FileHandle, AppendLog).
+    struct io_span
+    {
+        io_operation        Op          = io_operation::count;
+        const fs::path     *Path        = nullptr;
+        uint64_t            Token       = 0;
+        uint64_t            Bytes       = 0;        // End only
+        bool                Success     = false;    // End only
+        int64_t             DurationNs  = 0;        // End only
+    };
+
+    // Called on the calling thread, keep them cheap. They must not throw or call setTraceHooks.
+    // AsyncIo requests are reported one by one from the i/o thread once they complete,
+    // Begin right before End, timed from submit.
+    struct trace_hooks
+    {
+        std::function<void(fs::io_span &)>          Begin;
+        std::function<void(const fs::io_span &)>    End;
+    };
+
 #if defined PLATFORM_WIN
     struct file_metadata
     {
@@ -131,10 +448,833 @@ namespace fs
         LIB_EXPORT bool             setFileMetadata(const fs::path &Path, const fs::file_metadata &attributes);
         DEFINE_COMMON_FS()
     };
+#else
+    enum class map_advice : uint8_t
+    {
+        normal,
+        sequential,
+        random,
+        willneed,
+        dontneed,
+        hugepage,
+    };
+
+    struct map_options
+    {
+        bool        Populate = false;                   // MAP_POPULATE, prefault the whole file up front
+        map_advice  Advice   = map_advice::normal;      // madvise applied to the whole mapping
+    };
+
+    struct remove_options
+    {
+        unsigned    Threads     = 0;        // 0 - hardware_concurrency
+        bool        StopOnError = true;     // false: keep removing what can be removed, still report failure
+    };
+
+    enum class clone_mode : uint8_t
+    {
+        automatic,  // reflink when the filesystem can, copy otherwise
+        always,     // fail unless the data can be shared
+        never,
+    };
+
+    struct copy_options
+    {
+        bool        Overwrite       = true;
+        bool        PreserveMode    = true;
+        bool        PreserveTimes   = false;
+        clone_mode  Reflink         = clone_mode::automatic;
+        unsigned    Threads         = 0;        // copyTree workers, 0 - hardware_concurrency
+        bool        StopOnError     = true;     // copyTree only
+    };
+
+    enum class walk_action : uint8_t
+    {
+        next,       // keep going
+        skip,       // don't descend into this directory
+        stop,       // end the walk
+    };
+
+    // Entry handed to a walk visitor, only valid during the callback.
+    struct walk_entry
+    {
+        std::string_view    Name;
+        std::string_view    Parent;             // directory relative to the walk root, "" for the root itself
+        entry_type          Type        = entry_type::unknown;
+        unsigned            Depth       = 0;    // 1 for the root's direct children
+        uint64_t            Inode       = 0;
+        int                 DirHandle   = -1;   // open parent directory, usable with openat & co.
+
+        // Path relative to the walk root, built on request
+        fs::path            path() const;
+        // fstatat relative to DirHandle on first use (symlinks not followed), nullptr on failure
+        const struct stat  *stat() const;
+
+    private:
+        mutable struct stat m_stat;
+        mutable int8_t      m_statState = 0;    // 0 - not fetched, 1 - fetched, -1 - failed
+    };
+
+    using walk_visitor = std::function<walk_action(const fs::walk_entry &entry)>;
+
+    struct walk_options
+    {
+        unsigned    MaxDepth        = 0;            // 0 - unlimited, 1 - direct children only
+        std::size_t BufferSize      = 64u << 10;    // getdents64 buffer per directory level
+        bool        StopOnError     = false;        // unreadable directories are skipped otherwise
+        NameFilter  Filter;                         // entries not matching aren't visited, directories are still descended
+    };
+
+    // Opt-in memo of expandPath results, keyed by cwd + path for relative
+    // input. Entries go stale when symlinks or directories along the path
+    // change, invalidatePathCache() (or a short Ttl) covers that.
+    struct path_cache_options
+    {
+        bool                        Enabled     = false;
+        std::size_t                 Capacity    = 4096;     // least recently used entries are dropped beyond this
+        std::chrono::milliseconds   Ttl         { 1000 };   // 0 - until invalidated or evicted
+    };
+
+    // Open directory used as the base of fd-relative (openat & co.) operations,
+    // names are resolved by the kernel relative to it without any path expansion.
+    class LIB_EXPORT DirHandle
+    {
+    public:
+        DirHandle() = default;
+        explicit DirHandle(const fs::path &Path)    { open(Path); }
+        DirHandle(DirHandle &&other) noexcept;
+        DirHandle &operator=(DirHandle &&other) noexcept;
+        DirHandle(const DirHandle &) = delete;
+        DirHandle &operator=(const DirHandle &) = delete;
+        ~DirHandle();
+
+        bool open(const fs::path &Path);
+        void close();
+        // Subdirectory as a base of its own
+        DirHandle openDir(const fs::path &name) const;
+        explicit operator bool() const              { return m_handle >= 0; }
+        int handle() const                          { return m_handle; }
+
+        bool readFile(const fs::path &name, fs::ReadBuffer &data) const;
+        bool readFile(const fs::path &name, std::vector<uint8_t> &data) const;
+        bool readFile(const fs::path &name, std::string &data) const;
+        bool writeFile(const fs::path &name, std::string_view data) const;
+        bool writeFile(const fs::path &name, const std::vector<uint8_t> &data) const;
+        bool appendFile(const fs::path &name, std::string_view data) const;
+        // Symlinks are followed, same as the path based api
+        bool stat(const fs::path &name, struct stat &stats) const;
+        bool isExist(const fs::path &name) const;
+        bool isDirectory(const fs::path &name) const;
+        bool removeFile(const fs::path &name) const;
+        // Empty directories only
+        bool removeDir(const fs::path &name) const;
+        // Single level, an existing directory counts as success
+        bool createDirectory(const fs::path &name) const;
+
+    private:
+        int m_handle = -1;
+    };
+
+    // Open file for repeated positional access (pread / pwrite). Nothing is
+    // buffered and the file offset is never used, so one handle can serve many threads.
+    class LIB_EXPORT FileHandle
+    {
+    public:
+        FileHandle() = default;
+        explicit FileHandle(const fs::path &filePath, const bool writable = false)    { open(filePath, writable); }
+        FileHandle(FileHandle &&other) noexcept;
+        FileHandle &operator=(FileHandle &&other) noexcept;
+        FileHandle(const FileHandle &) = delete;
+        FileHandle &operator=(const FileHandle &) = delete;
+        ~FileHandle();
+
+        // writable opens read-write and creates the file when missing
+        bool open(const fs::path &filePath, const bool writable = false);
+        void close();
+        explicit operator bool() const              { return m_handle >= 0; }
+        int handle() const                          { return m_handle; }
+        // Current size, 0 on error
+        uint64_t size() const;
+
+        // Short past EOF, readBytes == 0 at or beyond it
+        bool readAt(const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes) const;
+        bool readAt(const uint64_t offset, const std::size_t length, fs::ReadBuffer &data) const;
+        bool writeAt(const uint64_t offset, const void *data, const std::size_t length) const;
+        bool writeAt(const uint64_t offset, std::string_view data) const    { return writeAt(offset, data.data(), data.size()); }
+        // posix_fadvise over [offset, offset + length), length 0 - up to the end.
+        // willneed starts the readahead right away, hugepage has no meaning here.
+        bool advise(const map_advice advice, const uint64_t offset = 0, const uint64_t length = 0) const;
+        bool sync(const bool dataOnly = true) const;
+
+    private:
+        int m_handle = -1;
+    };
+
+    // Read-only view of a mmap'ed file, unmapped on destruction.
+    // Empty files give a valid view with no data.
+    class LIB_EXPORT MappedFile
+    {
+    public:
+        MappedFile() = default;
+        // Adopts a mapping created with mmap, it will be released with munmap.
+        MappedFile(void *address, std::size_t size);
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+
+        explicit operator bool() const  { return m_valid; }
+        const std::byte *data() const   { return m_data; }
+        std::size_t size() const        { return m_size; }
+        bool empty() const              { return m_size == 0; }
+        std::string_view view() const   { return { reinterpret_cast<const char *>(m_data), m_size }; }
+#if defined IS_CPP_20G
+        std::span<const std::byte> bytes() const { return { m_data, m_size }; }
+#endif
+        // length == 0 means "up to the end of the mapping"
+        bool advise(const map_advice advice, const std::size_t offset = 0, const std::size_t length = 0) const;
+        void reset();
+
+    private:
+        const std::byte    *m_data  = nullptr;
+        std::size_t         m_size  = 0;
+        bool                m_valid = false;
+    };
+
+    enum class hash_algorithm : uint8_t
+    {
+        crc32c,     // Castagnoli CRC, SSE4.2 / ARMv8 CRC instructions when present. Parts hash in parallel and combine.
+        xxh64,      // 64-bit xxHash, seed 0. Sequential only.
+    };
+
+    struct hash_options
+    {
+        hash_algorithm  Algorithm   = hash_algorithm::crc32c;
+        std::size_t     ChunkSize   = 4u << 20;     // read size, and the unit of parallel work for crc32c
+        unsigned        Threads     = 0;            // 0 - hardware concurrency, 1 - no workers
+    };
+
+    // Hash of some bytes: the expected value on a verified read, the computed one on a write
+    struct checksum
+    {
+        hash_algorithm  Algorithm   = hash_algorithm::crc32c;
+        uint64_t        Value       = 0;
+    };
+
+    // Incremental hasher, digest() may be taken at any point and doesn't end the stream
+    class LIB_EXPORT Hasher
+    {
+    public:
+        explicit Hasher(const hash_algorithm algorithm = hash_algorithm::crc32c) : m_algorithm(algorithm) { reset(); }
+
+        void reset();
+        void update(const void *data, const std::size_t size);
+        void update(std::string_view data)  { update(data.data(), data.size()); }
+        uint64_t digest() const;
+        hash_algorithm algorithm() const    { return m_algorithm; }
+        uint64_t total() const              { return m_total; }
+
+        static uint64_t hash(const hash_algorithm algorithm, const void *data, const std::size_t size);
+        // crc32c of A + B from crc32c(A), crc32c(B) and the size of B
+        static uint32_t crc32cCombine(const uint32_t first, const uint32_t second, const uint64_t secondSize);
+
+    private:
+        hash_algorithm  m_algorithm;
+        uint64_t        m_total     = 0;
+        uint64_t        m_state[4]  = {};       // crc register / xxh64 lanes
+        uint8_t         m_tail[32]  = {};       // xxh64 input short of a whole stripe
+    };
+
+    struct stream_options
+    {
+        std::size_t ChunkSize   = 1u << 20;     // nextChunk size / write buffer size
+        bool        Sequential  = true;         // posix_fadvise(SEQUENTIAL) on open
+        bool        DropBehind  = false;        // posix_fadvise(DONTNEED) consumed ranges, keeps page cache clean
+        // O_DIRECT through block aligned buffers, the page cache is not touched at all.
+        // Where the filesystem refuses it (tmpfs) readers fall back to DropBehind and
+        // writers to plain writes, direct() tells which one is in use. Appending writers never go direct.
+        bool        Direct      = false;
+        // Hash every byte handed out / taken in the same pass, see checksum()
+        bool            Checksum            = false;
+        hash_algorithm  ChecksumAlgorithm   = hash_algorithm::crc32c;
+    };
+
+    // Chunked sequential reader, memory use is bounded by ChunkSize whatever the file size.
+    class LIB_EXPORT FileReader
+    {
+    public:
+        FileReader() = default;
+        explicit FileReader(const fs::path &filePath, const stream_options &options = {}) { open(filePath, options); }
+        FileReader(FileReader &&other) noexcept;
+        FileReader &operator=(FileReader &&other) noexcept;
+        FileReader(const FileReader &) = delete;
+        FileReader &operator=(const FileReader &) = delete;
+        ~FileReader()                       { close(); }
+
+        bool open(const fs::path &filePath, const stream_options &options = {});
+        void close();
+        bool isOpen() const                 { return m_handle >= 0; }
+        explicit operator bool() const      { return isOpen() && !m_failed; }
+        bool eof() const                    { return m_eof; }
+        bool failed() const                 { return m_failed; }
+        uint64_t offset() const             { return m_offset; }
+        // Size at open time
+        uint64_t size() const               { return m_size; }
+        bool direct() const                 { return m_direct; }
+        // Hash of the bytes handed out since open, in the order they were (seeks don't reset it).
+        // Needs stream_options::Checksum, kept after close().
+        uint64_t checksum() const           { return m_hasher.digest(); }
+        bool seek(const uint64_t offset);
+
+        // readBytes == 0 with true result means EOF
+        bool readSome(void *data, const std::size_t size, std::size_t &readBytes);
+        // Chunk stays valid until the next call, false on EOF or error
+        bool nextChunk(std::string_view &chunk);
+#if defined IS_CPP_20G
+        bool nextChunk(std::span<const std::byte> &chunk);
+#endif
+
+    private:
+        // Untraced bodies of readSome / nextChunk
+        bool readInto(void *data, const std::size_t size, std::size_t &readBytes);
+        bool readChunk(std::string_view &chunk);
+        bool readDirect(const std::size_t size, const std::byte *&start, std::size_t &readBytes);
+
+        int             m_handle    = -1;
+        stream_options  m_options;
+        ReadBuffer      m_buffer;
+        Hasher          m_hasher;
+        uint64_t        m_offset    = 0;
+        uint64_t        m_size      = 0;
+        uint64_t        m_dropped   = 0;
+        bool            m_eof       = false;
+        bool            m_failed    = false;
+        bool            m_direct    = false;
+    };
+
+    // Buffered sequential writer. Data reaches the kernel on flush() (or when the
+    // buffer fills), the disk on sync(). Closing flushes.
+    class LIB_EXPORT FileWriter
+    {
+    public:
+        FileWriter() = default;
+        explicit FileWriter(const fs::path &filePath, const bool append = false, const stream_options &options = {}) { open(filePath, append, options); }
+        FileWriter(FileWriter &&other) noexcept;
+        FileWriter &operator=(FileWriter &&other) noexcept;
+        FileWriter(const FileWriter &) = delete;
+        FileWriter &operator=(const FileWriter &) = delete;
+        ~FileWriter()                       { close(); }
+
+        bool open(const fs::path &filePath, const bool append = false, const stream_options &options = {});
+        bool close();
+        bool isOpen() const                 { return m_handle >= 0; }
+        explicit operator bool() const      { return isOpen() && !m_failed; }
+        bool failed() const                 { return m_failed; }
+        bool direct() const                 { return m_direct; }
+        uint64_t written() const            { return m_written; }
+        // Hash of everything written since open. Needs stream_options::Checksum, kept after close().
+        uint64_t checksum() const           { return m_hasher.digest(); }
+
+        bool write(const void *data, const std::size_t size);
+        bool write(std::string_view data)   { return write(data.data(), data.size()); }
+#if defined IS_CPP_20G
+        bool write(std::span<const std::byte> data) { return write(data.data(), data.size()); }
+#endif
+        bool flush();
+        // flush + fdatasync (or fsync when dataOnly is false)
+        bool sync(const bool dataOnly = true);
+
+    private:
+        // Untraced bodies of write / flush
+        bool put(const void *data, const std::size_t size);
+        bool flushBuffer();
+        bool flushDirect();
+
+        int             m_handle    = -1;
+        stream_options  m_options;
+        ReadBuffer      m_buffer;
+        Hasher          m_hasher;
+        uint64_t        m_written   = 0;
+        uint64_t        m_flushed   = 0;        // direct: file offset of the aligned buffer start
+        std::size_t     m_pending   = 0;        // direct: bytes in the aligned buffer
+        bool            m_failed    = false;
+        bool            m_direct    = false;
+    };
+
+    enum class io_op : uint8_t
+    {
+        read,
+        write,
+        append,
+    };
+
+    enum class sync_policy : uint8_t
+    {
+        none,       // atomic replace only, a crash may still lose the new content
+        data,       // fdatasync the file before it replaces the target
+        full,       // fsync, metadata included
+    };
+
+    struct atomic_write_options
+    {
+        sync_policy Sync            = sync_policy::data;
+        bool        SyncDirectory   = true;     // fsync the parent after rename, makes the rename itself durable
+        bool        KeepMode        = true;     // take over the permissions of the replaced file
+                                                // (a symlink at the target is replaced by the file, not followed)
+        unsigned    Threads         = 0;        // writeFilesAtomic workers, 0 - hardware_concurrency
+    };
+
+    struct atomic_write
+    {
+        fs::path            Path;
+        std::string_view    Data;
+    };
+
+    struct io_request
+    {
+        io_op               Op      = io_op::read;
+        fs::path            Path;
+        // write / append payload, has to stay valid until the request completes
+        std::string_view    Data;
+    };
+
+    struct io_result
+    {
+        bool                Success     = false;
+        int                 Error       = 0;    // errno of the failed step
+        std::size_t         Transferred = 0;
+        ReadBuffer          Data;               // read contents
+    };
+
+    // readFiles / writeFiles: files are grouped by parent directory, opened with
+    // openat relative to one directory fd, and spread over a worker pool.
+    // Results come back in request order, requests for the same file run in no particular order.
+    struct batch_options
+    {
+        unsigned    Threads         = 0;                    // 0 - hardware_concurrency
+        std::size_t FilesPerTask    = 16;                   // files of one directory handed to a worker at once
+        sync_policy Sync            = sync_policy::none;    // writes only
+    };
+
+    struct mkdir_options
+    {
+        unsigned                            Threads = 0;        // 0 - hardware_concurrency
+        mode_t                              Mode    = 0777;     // umask applies
+        // Optional memo kept by the caller between calls: directories in it are
+        // trusted without a syscall, the ones created or found are added.
+        // Stale when directories get removed behind its back.
+        std::unordered_set<std::string>    *Known   = nullptr;
+    };
+
+    struct async_options
+    {
+        unsigned    QueueDepth  = 64;       // requests in flight per io_uring round trip
+        unsigned    Workers     = 0;        // fallback pool size, 0 - picked from hardware_concurrency
+        bool        UseIoUring  = true;
+    };
+
+    // Batched whole-file read / write / append. Batches go through io_uring
+    // (open, i/o and close of QueueDepth files per round trip) when the kernel
+    // supports it, otherwise through a pool of threads doing pread / pwrite.
+    class LIB_EXPORT AsyncIo
+    {
+    public:
+        // Called on an i/o thread, index is the position of the request in its batch
+        using callback = std::function<void(const std::size_t index, io_result &&result)>;
+
+        explicit AsyncIo(const async_options &options = {});
+        AsyncIo(const AsyncIo &) = delete;
+        AsyncIo &operator=(const AsyncIo &) = delete;
+        // Waits for everything already submitted
+        ~AsyncIo();
+
+        bool usingIoUring() const;
+        std::vector<std::future<io_result>> submit(std::vector<io_request> batch);
+        void submit(std::vector<io_request> batch, callback onComplete);
+        // submit + wait
+        std::vector<io_result> run(std::vector<io_request> batch);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    enum class cache_validation : uint8_t
+    {
+        stat,       // one stat per lookup, (device, inode, size, mtime, ctime) must still match
+        inotify,    // hits cost no syscall, a watcher thread drops entries on directory events
+    };
+
+    struct file_cache_options
+    {
+        std::size_t         MaxBytes        = 64u << 20;    // least recently used files are dropped beyond this
+        std::size_t         MaxFileSize     = 1u << 20;     // bigger files are read but not kept
+        cache_validation    Validation      = cache_validation::stat;
+    };
+
+    struct file_cache_stats
+    {
+        uint64_t    Hits            = 0;
+        uint64_t    Misses          = 0;
+        uint64_t    Evictions       = 0;
+        uint64_t    Invalidations   = 0;    // entries dropped because the file changed
+        std::size_t Entries         = 0;
+        std::size_t Bytes           = 0;
+    };
+
+    // Read-through cache for small hot files. Contents are shared and
+    // immutable: a hit is a hash lookup plus a reference count bump, a changed
+    // file gets a new buffer while readers keep the old one.
+    // With inotify validation the directories named in the path are watched, a
+    // file reached through a symlink changing its target isn't noticed; use
+    // stat validation for those. inotify falls back to stat when it can't be set up.
+    class LIB_EXPORT FileCache
+    {
+    public:
+        using buffer = std::shared_ptr<const fs::ReadBuffer>;
+
+        explicit FileCache(const file_cache_options &options = {});
+        FileCache(const FileCache &) = delete;
+        FileCache &operator=(const FileCache &) = delete;
+        ~FileCache();
+
+        // nullptr when the file can't be read
+        buffer read(const fs::path &filePath);
+        void invalidate(const fs::path &filePath);
+        void clear();
+        // stat when inotify was asked for but isn't available, or its watcher thread failed
+        cache_validation validation() const;
+        file_cache_stats stats() const;
+        void resetStats();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    enum class log_sync : uint8_t
+    {
+        none,       // only on sync() and close()
+        interval,   // fdatasync at most every SyncInterval while there is unsynced data
+        bytes,      // fdatasync once SyncBytes were written since the last one
+    };
+
+    struct append_log_options
+    {
+        std::size_t                 Capacity        = 4096;     // records queued before append waits, rounded up to a power of two
+        log_sync                    Sync            = log_sync::none;
+        std::chrono::milliseconds   SyncInterval    { 100 };
+        std::size_t                 SyncBytes       = 1u << 20;
+    };
+
+    // Append-only file kept open for its whole life. append() only queues the
+    // record in a lock-free ring; a flusher thread writes whatever piled up
+    // since its last round with a single writev (group commit) and applies the
+    // sync policy. Records from one thread keep their order, records are never interleaved.
+    class LIB_EXPORT AppendLog
+    {
+    public:
+        AppendLog();
+        explicit AppendLog(const fs::path &filePath, const append_log_options &options = {});
+        AppendLog(AppendLog &&other) noexcept;
+        AppendLog &operator=(AppendLog &&other) noexcept;
+        AppendLog(const AppendLog &) = delete;
+        AppendLog &operator=(const AppendLog &) = delete;
+        // Writes out what is queued, see close()
+        ~AppendLog();
+
+        bool open(const fs::path &filePath, const append_log_options &options = {});
+        // Flushes, syncs unless the policy is none, and closes. No append may run concurrently.
+        bool close();
+        bool isOpen() const;
+
+        // False once the log is closed or a write failed
+        bool append(std::string_view record);
+        // Blocks until everything appended before the call reached the file
+        bool flush();
+        // flush + fdatasync
+        bool sync();
+
+        bool failed() const;
+        uint64_t written() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    struct compress_options
+    {
+        std::size_t BlockSize       = 1u << 20;     // unit of random access and of parallel work, 4 KiB - 1 GiB
+        unsigned    Threads         = 0;            // 0 - hardware concurrency, 1 - inline
+        int         Acceleration    = 1;            // > 1 gives up ratio for speed
+    };
+
+    // Compressed files are a header, independently compressed blocks (LZ4 block
+    // format, incompressible ones stored as is) and an index of the blocks at
+    // the end, so a range decodes only the blocks it covers.
+    // Appending writes the new blocks over the old index, then the merged index,
+    // and ends the last block early; small appends are better batched or kept in
+    // one open writer. A failed append puts the old index back, a crash before
+    // close() leaves a file that doesn't read as a compressed file.
+
+    // Compressing counterpart of FileWriter. Full blocks are compressed on Threads
+    // workers as they come, close() writes the last block and the index.
+    class LIB_EXPORT CompressedWriter
+    {
+    public:
+        CompressedWriter();
+        explicit CompressedWriter(const fs::path &filePath, const bool append = false, const compress_options &options = {});
+        CompressedWriter(CompressedWriter &&other) noexcept;
+        CompressedWriter &operator=(CompressedWriter &&other) noexcept;
+        CompressedWriter(const CompressedWriter &) = delete;
+        CompressedWriter &operator=(const CompressedWriter &) = delete;
+        ~CompressedWriter();
+
+        // Appending to a missing or empty file creates it, anything that isn't a compressed file fails
+        bool open(const fs::path &filePath, const bool append = false, const compress_options &options = {});
+        // Without close() the file has no index and can't be read back
+        bool close();
+        bool isOpen() const;
+        explicit operator bool() const      { return isOpen() && !failed(); }
+        bool failed() const;
+        // Uncompressed bytes taken since open
+        uint64_t written() const;
+
+        bool write(const void *data, const std::size_t size);
+        bool write(std::string_view data)   { return write(data.data(), data.size()); }
+#if defined IS_CPP_20G
+        bool write(std::span<const std::byte> data) { return write(data.data(), data.size()); }
+#endif
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    // Decompressing counterpart of FileReader with random access. Not thread safe.
+    class LIB_EXPORT CompressedReader
+    {
+    public:
+        CompressedReader();
+        explicit CompressedReader(const fs::path &filePath);
+        CompressedReader(CompressedReader &&other) noexcept;
+        CompressedReader &operator=(CompressedReader &&other) noexcept;
+        CompressedReader(const CompressedReader &) = delete;
+        CompressedReader &operator=(const CompressedReader &) = delete;
+        ~CompressedReader();
+
+        bool open(const fs::path &filePath);
+        void close();
+        bool isOpen() const;
+        explicit operator bool() const      { return isOpen(); }
+        // Uncompressed size
+        uint64_t size() const;
+        std::size_t blockCount() const;
+        uint64_t offset() const;
+        bool eof() const;
+        bool seek(const uint64_t offset);
+
+        // [offset, offset + length) clipped to size()
+        bool read(const uint64_t offset, const std::size_t length, fs::ReadBuffer &data);
+        // Whole contents, blocks are decoded on threads workers
+        bool readAll(fs::ReadBuffer &data, const unsigned threads = 0);
+        // From offset() to the end of its block. Stays valid until the next call, false on EOF or error
+        bool nextChunk(std::string_view &chunk);
+#if defined IS_CPP_20G
+        bool nextChunk(std::span<const std::byte> &chunk);
+#endif
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    enum class change_type : uint8_t
+    {
+        added,
+        removed,
+        modified,   // files by content, symlinks by target
+        moved,      // file removed at From and added at Path with the same content
+    };
+
+    // Paths are relative to the compared roots
+    struct tree_change
+    {
+        change_type Type    = change_type::modified;
+        entry_type  Kind    = entry_type::file;
+        fs::path    Path;               // in the new tree, in the old one for removed
+        fs::path    From;               // moved only
+        uint64_t    Size    = 0;        // files, new size unless removed
+    };
+
+    // diffTrees / findDuplicates go from cheap to expensive: sizes (and mtimes)
+    // from the walk first, then a hash of both ends of the files still alike,
+    // then a full hash of the ones even that can't tell apart. Hashing runs on Threads workers.
+    // Both return false when something couldn't be read, what was found is still reported:
+    // such files count as modified for diffTrees and are left out of findDuplicates groups,
+    // which hold paths under the searched root, one per inode.
+    struct compare_options
+    {
+        unsigned        Threads         = 0;        // 0 - hardware_concurrency
+        hash_algorithm  Algorithm       = hash_algorithm::xxh64;
+        std::size_t     PartialSize     = 64u << 10;    // hashed at each end before the full hash, 0 - full hash only
+        bool            TrustMetadata   = true;     // diffTrees: same size and mtime is unchanged without reading
+        bool            DetectMoves     = true;     // diffTrees: pair removed and added files of the same content
+        uint64_t        MinSize         = 1;        // findDuplicates: smaller files are left out
+        NameFilter      Filter;                     // entries not matching are left out, directories are still descended
+    };
+
+    // Entry of a DirIndex, Path points into the index and is valid while it is neither changed nor destroyed
+    struct index_entry
+    {
+        std::string_view    Path;               // relative to the root, '/' separated
+        entry_type          Type        = entry_type::unknown;
+        uint64_t            Size        = 0;    // files
+        int64_t             ModifyTime  = 0;    // nanoseconds since the unix epoch
+        uint64_t            Hash        = 0;    // files of a hashed index
+
+        std::string_view    name() const        { const auto pos = Path.rfind('/'); return pos == Path.npos ? Path : Path.substr(pos + 1); }
+    };
+
+    struct dir_index_options
+    {
+        bool            Hash        = false;    // build: hash every file, refresh keeps doing it for a hashed index
+        hash_algorithm  Algorithm   = hash_algorithm::xxh64;
+        unsigned        Threads     = 0;        // stat / hash workers, 0 - hardware_concurrency
+        // refresh: re-stat the files of unchanged directories too. Without it only
+        // entries added, removed or renamed are noticed, not files rewritten in place.
+        bool            StatFiles   = false;
+        // Files / symlinks not matching are left out. Directories are always kept,
+        // refresh needs their mtimes; pass it the same filter as build.
+        NameFilter      Filter;
+    };
+
+    // Snapshot of a directory tree kept as entries sorted by path, so lookups,
+    // listings and prefix / name queries are binary searches without a syscall.
+    // save() writes it as a flat file (header, fixed size records, path blob)
+    // that load() maps as is: nothing is parsed or allocated per entry.
+    // refresh() stats only the directories and re-reads the ones whose mtime
+    // moved, new subdirectories are walked whole.
+    class LIB_EXPORT DirIndex
+    {
+    public:
+        DirIndex();
+        DirIndex(DirIndex &&other) noexcept;
+        DirIndex &operator=(DirIndex &&other) noexcept;
+        DirIndex(const DirIndex &) = delete;
+        DirIndex &operator=(const DirIndex &) = delete;
+        ~DirIndex();
+
+        bool build(const fs::path &Path, const dir_index_options &options = {});
+        // changed (optional) receives the number of entries added, removed or updated
+        bool refresh(const dir_index_options &options = {}, std::size_t *changed = nullptr);
+        // Replaced atomically, a reader mapping the old file keeps it
+        bool save(const fs::path &filePath) const;
+        bool load(const fs::path &filePath);
+        void clear();
+
+        bool empty() const;
+        std::size_t size() const;
+        const fs::path &root() const;
+        bool hashed() const;
+        // In path order
+        fs::index_entry entry(const std::size_t position) const;
+
+        bool find(std::string_view path, fs::index_entry &result) const;
+        // Direct children of a directory, "" for the root
+        std::vector<fs::index_entry> list(std::string_view directory) const;
+        // Entries whose path starts with prefix, "dir/" for a whole subtree
+        std::vector<fs::index_entry> prefix(std::string_view prefix) const;
+        // Entries under directory ("" - everywhere) whose name matches, NameFilter::glob for globs
+        std::vector<fs::index_entry> match(const fs::NameFilter &filter, std::string_view directory = {}, const bool recursive = true) const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+    enum class watch_event_type : uint8_t
+    {
+        created,
+        modified,       // content written, files only
+        removed,
+        moved,          // From -> Path, both under watched roots; anything else is a removal / creation
+        rescan,         // events under Path were lost (kernel queue overflow), look at it again
+    };
+
+    struct watch_event
+    {
+        watch_event_type    Type    = watch_event_type::modified;
+        entry_type          Kind    = entry_type::file;     // directory or file (anything else)
+        fs::path            Path;
+        fs::path            From;                           // moved only
+    };
+
+    struct watcher_options
+    {
+        // Events are held this long from the first one of a batch, so bursts on
+        // one path come out as a single event; 0 - a batch per inotify read
+        std::chrono::milliseconds   Latency         { 50 };
+        // Directories left without a watch (inotify limit reached) are listed and compared this often
+        std::chrono::milliseconds   RescanInterval  { 1000 };
+        NameFilter                  Filter;         // files not matching aren't reported, directories always are
+        // Called with each batch on the watcher thread. Without it batches
+        // queue up for take() / wait() and handle() becomes readable.
+        std::function<void(std::vector<fs::watch_event> &&events)> Callback;
+    };
+
+    // inotify based change notifications for directory trees. A recursive root
+    // gets a watch per directory, directories created or moved in later are
+    // watched as they appear and their content is reported as created.
+    // Per batch, events on one path are coalesced (created + modified is
+    // created, created + removed is nothing, removed + created is modified)
+    // and rename pairs become one moved event.
+    // Directories inotify refuses (max_user_watches) are polled instead: only
+    // those are listed every RescanInterval, and differences reported like events.
+    class LIB_EXPORT Watcher
+    {
+    public:
+        explicit Watcher(const watcher_options &options = {});
+        Watcher(Watcher &&other) noexcept;
+        Watcher &operator=(Watcher &&other) noexcept;
+        Watcher(const Watcher &) = delete;
+        Watcher &operator=(const Watcher &) = delete;
+        // Stops the watcher thread, pending events are dropped
+        ~Watcher();
+
+        // False when inotify isn't available or the watcher thread failed
+        explicit operator bool() const;
+        // Existing content isn't reported
+        bool add(const fs::path &Path, const bool recursive = true);
+        bool remove(const fs::path &Path);
+        std::size_t watchCount() const;
+        std::size_t polledCount() const;
+
+        // Without a callback: readable while batches wait to be taken, -1 otherwise
+        int handle() const;
+        // Everything queued, oldest first. False when nothing was
+        bool take(std::vector<fs::watch_event> &events);
+        // take() once something is queued, false on timeout or once the watcher failed
+        bool wait(std::vector<fs::watch_event> &events, const std::chrono::milliseconds timeout);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
 #endif
     namespace posix
     {
         DEFINE_COMMON_FS()
+        DEFINE_POSIX_EXT_FS()
     };
     DEFINE_COMMON_FS()
+    DEFINE_POSIX_EXT_FS()
+
+    // Totals since start or the last resetIoStats(), threads that already exited included
+    LIB_EXPORT fs::io_stats                 getIoStats();
+    LIB_EXPORT void                         resetIoStats();
+    // Empty hooks switch tracing off. Returns once calls still running the previous hooks finished
+    LIB_EXPORT void                         setTraceHooks(const fs::trace_hooks &hooks);
 }
\ No newline at end of file
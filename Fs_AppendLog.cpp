@@ -0,0 +1,362 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+namespace
+{
+    // writev(2) until every vector is out, the array is consumed in place
+    bool writevFull(const int fileHandle, iovec *vectors, int count)
+    {
+        while (count > 0)
+        {
+            const ssize_t res = writev(fileHandle, vectors, count);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            auto done = static_cast<std::size_t>(res);
+            while (count > 0 && done >= vectors->iov_len)
+            {
+                done -= vectors->iov_len;
+                ++vectors;
+                --count;
+            }
+            if (count > 0)
+            {
+                vectors->iov_base = static_cast<char *>(vectors->iov_base) + done;
+                vectors->iov_len -= done;
+            }
+        }
+        return true;
+    }
+
+    std::size_t ringSize(const std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+}
+
+namespace fs
+{
+    struct AppendLog::Impl
+    {
+        // Bounded MPSC ring (Vyukov): a slot is free for position p when its
+        // Sequence equals p, and holds a published record when it equals p + 1.
+        struct Slot
+        {
+            std::atomic<std::size_t>    Sequence    { 0 };
+            std::string                 Record;
+        };
+
+        explicit Impl(const append_log_options &options)
+            : Options(options),
+              Mask(ringSize(options.Capacity) - 1),
+              Slots(new Slot[Mask + 1])
+        {
+            for (std::size_t i = 0; i <= Mask; ++i)
+            {
+                Slots[i].Sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(std::string_view record);
+        void wake();
+        bool waitFor(const bool withSync);
+        void run();
+
+        const append_log_options        Options;
+        const std::size_t               Mask;
+        std::unique_ptr<Slot[]>         Slots;
+        int                             Handle      = -1;
+        alignas(64) std::atomic<std::size_t> Tail   { 0 };      // next position handed to a producer
+        alignas(64) std::size_t         Head        = 0;        // next position to write, flusher only
+        std::atomic<std::size_t>        Flushed     { 0 };
+        std::atomic<uint64_t>           Written     { 0 };
+        std::atomic<bool>               Failed      { false };
+        std::atomic<bool>               Stop        { false };
+        std::atomic<bool>               Sleeping    { false };
+        std::mutex                      Lock;
+        std::condition_variable         Wake;
+        std::condition_variable         Done;
+        std::size_t                     SyncRequest = 0;        // under Lock
+        std::size_t                     Synced      = 0;        // under Lock
+        std::thread                     Flusher;
+    };
+
+    bool AppendLog::Impl::push(std::string_view record)
+    {
+        std::size_t pos = Tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (Failed.load(std::memory_order_relaxed) || Stop.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            Slot &slot = Slots[pos & Mask];
+            const std::size_t sequence = slot.Sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.Record.assign(record.data(), record.size());
+                    // seq_cst, pairs with the Sleeping handshake in run()
+                    slot.Sequence.store(pos + 1);
+                    wake();
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                // Ring is full, let the flusher catch up
+                wake();
+                std::this_thread::yield();
+                pos = Tail.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                pos = Tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void AppendLog::Impl::wake()
+    {
+        // Either the flusher sees the published record or the producer sees it sleeping
+        if (Sleeping.load())
+        {
+            std::lock_guard<std::mutex> guard(Lock);
+            Wake.notify_one();
+        }
+    }
+
+    bool AppendLog::Impl::waitFor(const bool withSync)
+    {
+        const std::size_t target = Tail.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> guard(Lock);
+        if (withSync)
+        {
+            SyncRequest = std::max(SyncRequest, target);
+        }
+        Wake.notify_one();
+        Done.wait(guard, [&]
+        {
+            return Failed.load() || (withSync ? Synced >= target : Flushed.load() >= target);
+        });
+        return !Failed.load();
+    }
+
+    void AppendLog::Impl::run()
+    {
+        std::vector<std::string>    batch;
+        std::vector<iovec>          vectors;
+        uint64_t                    unsynced    = 0;
+        auto                        last_sync   = std::chrono::steady_clock::now();
+        const std::size_t           group_limit = std::min<std::size_t>(Mask + 1, IOV_MAX);
+        auto ready = [&] { return Slots[Head & Mask].Sequence.load(std::memory_order_acquire) == Head + 1; };
+        auto dataSync = [&]
+        {
+            if (fdatasync(Handle) != 0)
+            {
+                Failed = true;
+            }
+            unsynced  = 0;
+            last_sync = std::chrono::steady_clock::now();
+        };
+
+        while (true)
+        {
+            // Take everything published so far. Swapping leaves the slot with a
+            // buffer from an earlier round, so producers rarely allocate.
+            std::size_t count = 0;
+            uint64_t    bytes = 0;
+            while (count < group_limit && ready())
+            {
+                Slot &slot = Slots[Head & Mask];
+                if (batch.size() <= count)
+                {
+                    batch.emplace_back();
+                }
+                batch[count].swap(slot.Record);
+                slot.Record.clear();
+                slot.Sequence.store(Head + Mask + 1, std::memory_order_release);
+                ++Head;
+                bytes += batch[count++].size();
+            }
+            if (count)
+            {
+                if (!Failed)
+                {
+                    vectors.resize(count);
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        vectors[i] = { batch[i].data(), batch[i].size() };
+                    }
+                    if (writevFull(Handle, vectors.data(), static_cast<int>(count)))
+                    {
+                        Written  += bytes;
+                        unsynced += bytes;
+                    }
+                    else
+                    {
+                        Failed = true;
+                    }
+                }
+                Flushed.store(Head, std::memory_order_release);
+            }
+
+            bool requested = false;
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                requested = SyncRequest > Synced && Head >= SyncRequest;
+            }
+            const bool by_policy =
+                unsynced != 0 &&
+                ((Options.Sync == log_sync::bytes    && unsynced >= Options.SyncBytes) ||
+                 (Options.Sync == log_sync::interval && std::chrono::steady_clock::now() - last_sync >= Options.SyncInterval));
+            if (!Failed && (requested || by_policy))
+            {
+                dataSync();
+            }
+            const bool stopping = Stop.load() && Tail.load() == Head;
+            if (stopping && !Failed && unsynced != 0 && Options.Sync != log_sync::none)
+            {
+                dataSync();
+            }
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                if (requested)
+                {
+                    Synced = Head;
+                }
+                Done.notify_all();
+            }
+            if (stopping)
+            {
+                break;
+            }
+            if (count)
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(Lock);
+            Sleeping.store(true);
+            const bool published = Slots[Head & Mask].Sequence.load() == Head + 1;
+            if (!published && !Stop.load() && SyncRequest <= Synced)
+            {
+                const auto timeout = Options.Sync == log_sync::interval ? Options.SyncInterval : std::chrono::milliseconds(100);
+                Wake.wait_for(guard, timeout);
+            }
+            else if (Stop.load() && !published)
+            {
+                // A producer reserved a slot but hasn't published it yet
+                guard.unlock();
+                std::this_thread::yield();
+                guard.lock();
+            }
+            Sleeping.store(false);
+        }
+    }
+
+    AppendLog::AppendLog() = default;
+
+    AppendLog::AppendLog(const fs::path &filePath, const append_log_options &options)
+    {
+        open(filePath, options);
+    }
+
+    AppendLog::AppendLog(AppendLog &&other) noexcept = default;
+
+    AppendLog &AppendLog::operator=(AppendLog &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_impl = std::move(other.m_impl);
+        }
+        return *this;
+    }
+
+    AppendLog::~AppendLog()
+    {
+        close();
+    }
+
+    bool AppendLog::open(const fs::path &filePath, const append_log_options &options)
+    {
+        close();
+        auto impl = std::make_unique<Impl>(options);
+        impl->Handle = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (impl->Handle < 0)
+        {
+            return false;
+        }
+        m_impl = std::move(impl);
+        m_impl->Flusher = std::thread(&Impl::run, m_impl.get());
+        return true;
+    }
+
+    bool AppendLog::close()
+    {
+        if (!m_impl)
+        {
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_impl->Lock);
+            m_impl->Stop = true;
+            m_impl->Wake.notify_one();
+        }
+        m_impl->Flusher.join();
+        const bool result = !m_impl->Failed.load();
+        fs::internal::closeHandle(m_impl->Handle);
+        m_impl.reset();
+        return result;
+    }
+
+    bool AppendLog::isOpen() const
+    {
+        return m_impl != nullptr;
+    }
+
+    bool AppendLog::append(std::string_view record)
+    {
+        FS_TRACED(append, nullptr, m_impl && m_impl->push(record), result_ ? record.size() : 0, result_)
+    }
+
+    bool AppendLog::flush()
+    {
+        FS_TRACED(sync, nullptr, m_impl && m_impl->waitFor(false), 0, result_)
+    }
+
+    bool AppendLog::sync()
+    {
+        FS_TRACED(sync, nullptr, m_impl && m_impl->waitFor(true), 0, result_)
+    }
+
+    bool AppendLog::failed() const
+    {
+        return m_impl && m_impl->Failed.load();
+    }
+
+    uint64_t AppendLog::written() const
+    {
+        return m_impl ? m_impl->Written.load() : 0;
+    }
+}
+#endif
@@ -0,0 +1,673 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define FS_HAS_IO_URING
+#endif
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+namespace
+{
+    // Single io op is capped, the tail of huge files is finished with the sync loops
+    constexpr std::size_t max_ring_io = 1u << 30;
+
+    int openFlags(const fs::io_op op)
+    {
+        switch (op)
+        {
+        case fs::io_op::write:  return O_WRONLY | O_CREAT | O_TRUNC  | O_CLOEXEC;
+        case fs::io_op::append: return O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+        default:                return O_RDONLY | O_CLOEXEC;
+        }
+    }
+
+    // Finishes a read whose first `done` bytes are already in data
+    bool readRest(const int fileHandle, const struct stat &stats, fs::ReadBuffer &data, std::size_t done)
+    {
+        std::size_t chunk = 0;
+        if (S_ISREG(stats.st_mode) && stats.st_size > 0)
+        {
+            if (!fs::internal::preadFull(fileHandle, data.data() + done, data.size() - done, done, chunk))
+            {
+                return false;
+            }
+            data.resizeForOverwrite(done + chunk);
+            return true;
+        }
+        // No usable size (procfs, pipes...), drain it
+        do
+        {
+            data.resizeForOverwrite(done + std::max<std::size_t>(4096, done / 2));
+            if (!fs::internal::preadFull(fileHandle, data.data() + done, data.size() - done, done, chunk))
+            {
+                return false;
+            }
+            done += chunk;
+        } while (done == data.size());
+        data.resizeForOverwrite(done);
+        return true;
+    }
+
+#if defined FS_INSTRUMENTATION
+    fs::io_operation traceOperation(const fs::io_op op)
+    {
+        switch (op)
+        {
+        case fs::io_op::write:  return fs::io_operation::write;
+        case fs::io_op::append: return fs::io_operation::append;
+        default:                return fs::io_operation::read;
+        }
+    }
+#endif
+
+    // Plain blocking path, used by the worker pool and to finish what the ring left over
+    void runRequest(const fs::io_request &request, fs::io_result &result)
+    {
+        int file_handle = open(request.Path.c_str(), openFlags(request.Op), 0666);
+        if (file_handle < 0)
+        {
+            result.Error = errno;
+            return;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        if (request.Op == fs::io_op::read)
+        {
+            struct stat stats;
+            if (fstat(file_handle, &stats) != 0)
+            {
+                result.Error = errno;
+                return;
+            }
+            result.Data.resizeForOverwrite(static_cast<std::size_t>(stats.st_size));
+            if (!readRest(file_handle, stats, result.Data, 0))
+            {
+                result.Error = errno;
+                result.Data.clear();
+                return;
+            }
+            result.Transferred = result.Data.size();
+        }
+        // O_APPEND ignores pwrite offsets, keep to write(2) for both
+        else if (!fs::internal::writeFull(file_handle, request.Data.data(), request.Data.size()))
+        {
+            result.Error = errno;
+            return;
+        }
+        else
+        {
+            result.Transferred = request.Data.size();
+        }
+        result.Success = true;
+    }
+
+#if defined FS_HAS_IO_URING
+    // Minimal io_uring wrapper over the raw syscalls, owned by a single thread.
+    class Uring
+    {
+    public:
+        Uring() = default;
+        Uring(const Uring &) = delete;
+        Uring &operator=(const Uring &) = delete;
+        ~Uring()
+        {
+            if (m_sqes)
+            {
+                munmap(m_sqes, m_sqesSize);
+            }
+            if (m_cqRing && m_cqRing != m_sqRing)
+            {
+                munmap(m_cqRing, m_cqRingSize);
+            }
+            if (m_sqRing)
+            {
+                munmap(m_sqRing, m_sqRingSize);
+            }
+            fs::internal::closeHandle(m_handle);
+        }
+
+        bool init(const unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            m_handle = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (m_handle < 0)
+            {
+                return false;
+            }
+            m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single_mmap)
+            {
+                m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+            }
+            m_sqRing = mapRing(m_sqRingSize, IORING_OFF_SQ_RING);
+            if (!m_sqRing)
+            {
+                return false;
+            }
+            m_cqRing = single_mmap ? m_sqRing : mapRing(m_cqRingSize, IORING_OFF_CQ_RING);
+            if (!m_cqRing)
+            {
+                return false;
+            }
+            m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            m_sqes = static_cast<io_uring_sqe *>(mapRing(m_sqesSize, IORING_OFF_SQES));
+            if (!m_sqes)
+            {
+                return false;
+            }
+            auto *sq     = static_cast<uint8_t *>(m_sqRing);
+            auto *cq     = static_cast<uint8_t *>(m_cqRing);
+            m_sqHead     = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            m_sqTail     = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            m_sqMask     = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            m_sqArray    = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            m_cqHead     = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            m_cqTail     = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            m_cqMask     = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            m_cqes       = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            m_sqEntries  = params.sq_entries;
+            m_localTail  = *m_sqTail;
+            return supportsOps();
+        }
+
+        unsigned capacity() const { return m_sqEntries; }
+
+        io_uring_sqe *nextSqe()
+        {
+            const unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (m_localTail - head >= m_sqEntries)
+            {
+                return nullptr;
+            }
+            const unsigned index = m_localTail & m_sqMask;
+            io_uring_sqe *sqe = &m_sqes[index];
+            std::memset(sqe, 0, sizeof(io_uring_sqe));
+            m_sqArray[index] = index;
+            ++m_localTail;
+            return sqe;
+        }
+
+        // Kernel CQE flags stay in the low bits, this one marks a CQE made up for a withdrawn SQE
+        static constexpr uint32_t withdrawn_flag = 1u << 31;
+
+        // The SQE never reached the kernel, nothing it asked for happened
+        static bool withdrawn(const io_uring_cqe &cqe) { return (cqe.flags & withdrawn_flag) != 0; }
+
+        // Publishes the queued SQEs and blocks until `count` completions were handed to onCqe.
+        // Every queued SQE gets exactly one onCqe call, whatever happens: false means
+        // io_uring_enter failed for good, SQEs the kernel never took are then withdrawn
+        // and reported as -ECANCELED with withdrawn_flag, the ones it took are still waited for.
+        template<typename F>
+        bool submitAndReap(unsigned count, F &&onCqe)
+        {
+            __atomic_store_n(m_sqTail, m_localTail, __ATOMIC_RELEASE);
+            bool broken = false;
+            while (count)
+            {
+                long res = 0;
+                if (!broken)
+                {
+                    const unsigned pending = m_localTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+                    res = syscall(__NR_io_uring_enter, m_handle, pending, count, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    {
+                        broken = true;
+                        // Without SQPOLL the kernel only takes SQEs inside io_uring_enter
+                        const unsigned sq_head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+                        for (unsigned i = sq_head; i != m_localTail; ++i, --count)
+                        {
+                            io_uring_cqe cqe {};
+                            cqe.user_data   = m_sqes[m_sqArray[i & m_sqMask]].user_data;
+                            cqe.res         = -ECANCELED;
+                            cqe.flags       = withdrawn_flag;
+                            onCqe(cqe);
+                        }
+                        m_localTail = sq_head;
+                        __atomic_store_n(m_sqTail, m_localTail, __ATOMIC_RELEASE);
+                    }
+                }
+                unsigned head = *m_cqHead;
+                const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+                const bool reaped = head != tail;
+                for (; head != tail && count; ++head, --count)
+                {
+                    onCqe(m_cqes[head & m_cqMask]);
+                }
+                __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+                if (count && !reaped && (broken || res < 0))
+                {
+                    // EAGAIN / EBUSY with nothing to reap, or in flight i/o on a ring we can't
+                    // enter anymore: completions are still posted to the CQ ring, so poll it
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            return !broken;
+        }
+
+    private:
+        void *mapRing(const std::size_t size, const off_t offset)
+        {
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_handle, offset);
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+
+        bool supportsOps()
+        {
+            constexpr unsigned ops_count = 256;
+            std::vector<uint8_t> storage(sizeof(io_uring_probe) + ops_count * sizeof(io_uring_probe_op));
+            auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+            if (syscall(__NR_io_uring_register, m_handle, IORING_REGISTER_PROBE, probe, ops_count) < 0)
+            {
+                return false;
+            }
+            for (const unsigned op : { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE })
+            {
+                if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int             m_handle        = -1;
+        void           *m_sqRing        = nullptr;
+        void           *m_cqRing        = nullptr;
+        io_uring_sqe   *m_sqes          = nullptr;
+        std::size_t     m_sqRingSize    = 0;
+        std::size_t     m_cqRingSize    = 0;
+        std::size_t     m_sqesSize      = 0;
+        unsigned       *m_sqHead        = nullptr;
+        unsigned       *m_sqTail        = nullptr;
+        unsigned       *m_sqArray       = nullptr;
+        unsigned       *m_cqHead        = nullptr;
+        unsigned       *m_cqTail        = nullptr;
+        io_uring_cqe   *m_cqes          = nullptr;
+        unsigned        m_sqMask        = 0;
+        unsigned        m_cqMask        = 0;
+        unsigned        m_sqEntries     = 0;
+        unsigned        m_localTail     = 0;
+    };
+#endif
+}
+
+namespace fs
+{
+    struct AsyncIo::Impl
+    {
+        struct Job
+        {
+            io_request              Request;
+            io_result               Result;
+            std::promise<io_result> Promise;
+        };
+
+        struct Batch
+        {
+            std::vector<Job>                        Jobs;
+            callback                                OnComplete;
+            std::size_t                             Next        = 0;
+            std::chrono::steady_clock::time_point   Submitted   = std::chrono::steady_clock::now();
+        };
+
+        async_options                       Options;
+        std::atomic<bool>                   UseRing { false };
+#if defined FS_HAS_IO_URING
+        Uring                               Ring;
+#endif
+        std::mutex                          Lock;
+        std::condition_variable             Wake;
+        std::deque<std::shared_ptr<Batch>>  Queue;
+        bool                                Stop    = false;
+        std::vector<std::thread>            Threads;
+
+        void complete(Batch &batch, const std::size_t index)
+        {
+            auto &job = batch.Jobs[index];
+#if defined FS_INSTRUMENTATION
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - batch.Submitted);
+            fs::internal::recordCompleted(traceOperation(job.Request.Op), &job.Request.Path, job.Result.Transferred, job.Result.Success, elapsed.count());
+#endif
+            if (batch.OnComplete)
+            {
+                batch.OnComplete(index, std::move(job.Result));
+            }
+            else
+            {
+                job.Promise.set_value(std::move(job.Result));
+            }
+        }
+
+        void workerLoop()
+        {
+            for (;;)
+            {
+                std::shared_ptr<Batch> batch;
+                std::size_t index = 0;
+                {
+                    std::unique_lock<std::mutex> lock(Lock);
+                    Wake.wait(lock, [&] { return Stop || !Queue.empty(); });
+                    if (Queue.empty())
+                    {
+                        return;
+                    }
+                    batch = Queue.front();
+                    index = batch->Next++;
+                    if (batch->Next == batch->Jobs.size())
+                    {
+                        Queue.pop_front();
+                    }
+                }
+                runRequest(batch->Jobs[index].Request, batch->Jobs[index].Result);
+                complete(*batch, index);
+            }
+        }
+
+#if defined FS_HAS_IO_URING
+        void ringLoop()
+        {
+            for (;;)
+            {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(Lock);
+                    Wake.wait(lock, [&] { return Stop || !Queue.empty(); });
+                    if (Queue.empty())
+                    {
+                        return;
+                    }
+                    batch = std::move(Queue.front());
+                    Queue.pop_front();
+                }
+                const std::size_t group = std::min<std::size_t>(Options.QueueDepth, Ring.capacity());
+                for (std::size_t first = 0; first < batch->Jobs.size(); first += group)
+                {
+                    const std::size_t last = std::min(first + group, batch->Jobs.size());
+                    if (!UseRing || !runRingGroup(*batch, first, last))
+                    {
+                        for (std::size_t i = first; i < last; ++i)
+                        {
+                            batch->Jobs[i].Result = {};
+                            runRequest(batch->Jobs[i].Request, batch->Jobs[i].Result);
+                        }
+                    }
+                    for (std::size_t i = first; i < last; ++i)
+                    {
+                        complete(*batch, i);
+                    }
+                }
+            }
+        }
+
+        // Three round trips for the whole group: open all, i/o all, close all
+        bool runRingGroup(Batch &batch, const std::size_t first, const std::size_t last)
+        {
+            const std::size_t count = last - first;
+            std::vector<int> handles(count, -1);
+            MakeScopeGuard([&] { for (auto &it : handles) { fs::internal::closeHandle(it); } });
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto &request = batch.Jobs[first + i].Request;
+                io_uring_sqe *sqe = Ring.nextSqe();
+                sqe->opcode     = IORING_OP_OPENAT;
+                sqe->fd         = AT_FDCWD;
+                sqe->addr       = reinterpret_cast<uint64_t>(request.Path.c_str());
+                sqe->len        = 0666;
+                sqe->open_flags = static_cast<uint32_t>(openFlags(request.Op));
+                sqe->user_data  = i;
+            }
+            if (!Ring.submitAndReap(static_cast<unsigned>(count), [&](const io_uring_cqe &cqe)
+                {
+                    if (cqe.res < 0)
+                    {
+                        batch.Jobs[first + cqe.user_data].Result.Error = -cqe.res;
+                    }
+                    else
+                    {
+                        handles[cqe.user_data] = cqe.res;
+                    }
+                }))
+            {
+                UseRing = false;
+                return false;
+            }
+
+            std::vector<struct stat> stats(count);
+            unsigned queued = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto &job = batch.Jobs[first + i];
+                if (handles[i] < 0)
+                {
+                    continue;
+                }
+                if (job.Request.Op == io_op::read && fstat(handles[i], &stats[i]) != 0)
+                {
+                    job.Result.Error = errno;
+                    fs::internal::closeHandle(handles[i]);
+                    continue;
+                }
+                io_uring_sqe *sqe = Ring.nextSqe();
+                if (job.Request.Op == io_op::read)
+                {
+                    job.Result.Data.resizeForOverwrite(static_cast<std::size_t>(stats[i].st_size));
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->addr   = reinterpret_cast<uint64_t>(job.Result.Data.data());
+                    sqe->len    = static_cast<uint32_t>(std::min(job.Result.Data.size(), max_ring_io));
+                }
+                else
+                {
+                    sqe->opcode = IORING_OP_WRITE;
+                    sqe->addr   = reinterpret_cast<uint64_t>(job.Request.Data.data());
+                    sqe->len    = static_cast<uint32_t>(std::min(job.Request.Data.size(), max_ring_io));
+                }
+                // O_APPEND makes the kernel ignore the offset
+                sqe->off        = 0;
+                sqe->fd         = handles[i];
+                sqe->user_data  = i;
+                ++queued;
+            }
+            std::vector<std::size_t> transferred(count, 0);
+            // submitAndReap reports every SQE, a broken ring included, so no buffer is
+            // handed back while the kernel may still touch it. Withdrawn i/o never
+            // started: zero bytes done, finishShortIo does all of it on the open handle
+            // like the open stage falling back to runRequest would.
+            std::vector<int> errors(count, ECANCELED);
+            if (!Ring.submitAndReap(queued, [&](const io_uring_cqe &cqe)
+                {
+                    errors[cqe.user_data] = cqe.res < 0 && !Uring::withdrawn(cqe) ? -cqe.res : 0;
+                    transferred[cqe.user_data] = cqe.res < 0 ? 0 : static_cast<std::size_t>(cqe.res);
+                }))
+            {
+                UseRing = false;
+            }
+
+            queued = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                auto &job = batch.Jobs[first + i];
+                if (handles[i] < 0)
+                {
+                    continue;
+                }
+                if (errors[i] == 0)
+                {
+                    finishShortIo(job, handles[i], stats[i], transferred[i]);
+                }
+                else
+                {
+                    job.Result.Error = errors[i];
+                    job.Result.Data.clear();
+                }
+                if (UseRing)
+                {
+                    io_uring_sqe *sqe = Ring.nextSqe();
+                    sqe->opcode     = IORING_OP_CLOSE;
+                    sqe->fd         = handles[i];
+                    sqe->user_data  = i;
+                    ++queued;
+                }
+            }
+            // Close results are not interesting, the data was already reported as transferred.
+            // Withdrawn closes leave their handle to the scope guard.
+            if (queued && !Ring.submitAndReap(queued, [&](const io_uring_cqe &cqe)
+                {
+                    if (!Uring::withdrawn(cqe))
+                    {
+                        handles[cqe.user_data] = -1;
+                    }
+                }))
+            {
+                UseRing = false;
+            }
+            return true;
+        }
+
+        void finishShortIo(Job &job, const int fileHandle, const struct stat &stats, const std::size_t done)
+        {
+            auto &result = job.Result;
+            if (job.Request.Op == io_op::read)
+            {
+                if (!readRest(fileHandle, stats, result.Data, done))
+                {
+                    result.Error = errno;
+                    result.Data.clear();
+                    return;
+                }
+                result.Transferred = result.Data.size();
+            }
+            else
+            {
+                // A write file is not O_APPEND and the ring write didn't move its position
+                const auto &data = job.Request.Data;
+                const bool written = job.Request.Op == io_op::append
+                    ? fs::internal::writeFull(fileHandle, data.data() + done, data.size() - done)
+                    : fs::internal::pwriteFull(fileHandle, data.data() + done, data.size() - done, done);
+                if (!written)
+                {
+                    result.Error = errno;
+                    return;
+                }
+                result.Transferred = data.size();
+            }
+            result.Success = true;
+        }
+#endif
+    };
+
+    AsyncIo::AsyncIo(const async_options &options)
+        : m_impl(std::make_unique<Impl>())
+    {
+        m_impl->Options = options;
+        if (m_impl->Options.QueueDepth == 0)
+        {
+            m_impl->Options.QueueDepth = async_options{}.QueueDepth;
+        }
+#if defined FS_HAS_IO_URING
+        m_impl->UseRing = options.UseIoUring && m_impl->Ring.init(m_impl->Options.QueueDepth);
+        if (m_impl->UseRing)
+        {
+            m_impl->Threads.emplace_back([this] { m_impl->ringLoop(); });
+            return;
+        }
+#endif
+        unsigned workers = options.Workers;
+        if (workers == 0)
+        {
+            // Blocking i/o, oversubscribing the cores is the point
+            workers = std::max(4u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < workers; ++i)
+        {
+            m_impl->Threads.emplace_back([this] { m_impl->workerLoop(); });
+        }
+    }
+
+    AsyncIo::~AsyncIo()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_impl->Lock);
+            m_impl->Stop = true;
+        }
+        m_impl->Wake.notify_all();
+        for (auto &it : m_impl->Threads)
+        {
+            it.join();
+        }
+    }
+
+    bool AsyncIo::usingIoUring() const
+    {
+        return m_impl->UseRing;
+    }
+
+    std::vector<std::future<io_result>> AsyncIo::submit(std::vector<io_request> batch)
+    {
+        std::vector<std::future<io_result>> result;
+        if (batch.empty())
+        {
+            return result;
+        }
+        auto job_batch = std::make_shared<Impl::Batch>();
+        job_batch->Jobs.resize(batch.size());
+        result.reserve(batch.size());
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            job_batch->Jobs[i].Request = std::move(batch[i]);
+            result.push_back(job_batch->Jobs[i].Promise.get_future());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_impl->Lock);
+            m_impl->Queue.push_back(std::move(job_batch));
+        }
+        m_impl->Wake.notify_all();
+        return result;
+    }
+
+    void AsyncIo::submit(std::vector<io_request> batch, callback onComplete)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        auto job_batch = std::make_shared<Impl::Batch>();
+        job_batch->Jobs.resize(batch.size());
+        job_batch->OnComplete = std::move(onComplete);
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            job_batch->Jobs[i].Request = std::move(batch[i]);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_impl->Lock);
+            m_impl->Queue.push_back(std::move(job_batch));
+        }
+        m_impl->Wake.notify_all();
+    }
+
+    std::vector<io_result> AsyncIo::run(std::vector<io_request> batch)
+    {
+        auto futures = submit(std::move(batch));
+        std::vector<io_result> result;
+        result.reserve(futures.size());
+        for (auto &it : futures)
+        {
+            result.push_back(it.get());
+        }
+        return result;
+    }
+}
+#endif
@@ -0,0 +1,207 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <map>
+
+namespace
+{
+    std::atomic<uint32_t> temp_counter { 0 };
+
+    // Staged file waiting for its rename
+    struct PendingWrite
+    {
+        int                 DirHandle   = -1;   // borrowed from the batch
+        std::string         Name;
+        std::string         TempName;
+        const void         *Data        = nullptr;
+        std::size_t         Size        = 0;
+        bool                Ready       = false;
+    };
+
+    int openParentEx(const fs::path &filePath)
+    {
+        const auto parent = filePath.parent_path();
+        return open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    bool syncEx(const int handle, const fs::sync_policy policy)
+    {
+        switch (policy)
+        {
+        case fs::sync_policy::data: return fdatasync(handle) == 0;
+        case fs::sync_policy::full: return fsync(handle) == 0;
+        default:                    return true;
+        }
+    }
+
+    // Writes and syncs a hidden sibling, nothing is visible under the target name yet
+    bool prepareEx(PendingWrite &pending, const fs::atomic_write_options &options)
+    {
+        int handle = -1;
+        // Keeps ".<name>.tmp.<pid>.<n>" under NAME_MAX
+        const auto stem = "." + pending.Name.substr(0, 200) + ".tmp." + std::to_string(getpid()) + ".";
+        for (int attempt = 0; attempt < 16 && handle < 0; ++attempt)
+        {
+            pending.TempName = stem + std::to_string(temp_counter++);
+            handle = openat(pending.DirHandle, pending.TempName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (handle < 0 && errno != EEXIST)
+            {
+                return false;
+            }
+        }
+        if (handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(handle); });
+        bool result = fs::internal::writeFull(handle, pending.Data, pending.Size);
+        struct stat stats;
+        // renameat replaces a symlink itself, not its target, so the mode comes from the link's own
+        // entry and only a regular file has one worth keeping
+        if (result && options.KeepMode && fstatat(pending.DirHandle, pending.Name.c_str(), &stats, AT_SYMLINK_NOFOLLOW) == 0 &&
+            S_ISREG(stats.st_mode))
+        {
+            result = fchmod(handle, stats.st_mode & 07777) == 0;
+        }
+        result = result && syncEx(handle, options.Sync);
+        if (!result)
+        {
+            unlinkat(pending.DirHandle, pending.TempName.c_str(), 0);
+        }
+        pending.Ready = result;
+        return result;
+    }
+
+    bool commitEx(const PendingWrite &pending)
+    {
+        if (renameat(pending.DirHandle, pending.TempName.c_str(), pending.DirHandle, pending.Name.c_str()) == 0)
+        {
+            return true;
+        }
+        unlinkat(pending.DirHandle, pending.TempName.c_str(), 0);
+        return false;
+    }
+
+    bool writeFileAtomicEx(const fs::path &filePath, const void *data, const std::size_t size, const fs::atomic_write_options &options)
+    {
+        PendingWrite pending;
+        pending.Name = filePath.filename().string();
+        if (pending.Name.empty())
+        {
+            return false;
+        }
+        pending.DirHandle = openParentEx(filePath);
+        if (pending.DirHandle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(pending.DirHandle); });
+        pending.Data = data;
+        pending.Size = size;
+        if (!prepareEx(pending, options) || !commitEx(pending))
+        {
+            return false;
+        }
+        return !options.SyncDirectory || fsync(pending.DirHandle) == 0;
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool writeFileAtomic(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::atomic_write_options &options)
+    {
+        return writeFileAtomicEx(filePath, data.data(), data.size(), options);
+    }
+
+    LIB_EXPORT
+    bool writeFileAtomic(const fs::path &filePath, std::string_view data, const fs::atomic_write_options &options)
+    {
+        return writeFileAtomicEx(filePath, data.data(), data.size(), options);
+    }
+
+    LIB_EXPORT
+    bool writeFileAtomic(const fs::path &filePath, std::wstring_view data, const fs::atomic_write_options &options)
+    {
+        return writeFileAtomicEx(filePath, data.data(), data.size() * sizeof(wchar_t), options);
+    }
+
+#if defined IS_CPP_20G
+    LIB_EXPORT
+    bool writeFileAtomic(const fs::path &filePath, std::span<const std::byte> data, const fs::atomic_write_options &options)
+    {
+        return writeFileAtomicEx(filePath, data.data(), data.size(), options);
+    }
+#endif
+
+    // All files are staged and synced first, nothing is renamed unless every one
+    // of them made it. Each parent directory is opened and fsync'ed only once.
+    LIB_EXPORT
+    bool writeFilesAtomic(const std::vector<fs::atomic_write> &files, const fs::atomic_write_options &options)
+    {
+        std::map<fs::path, int> directories;
+        MakeScopeGuard([&] { for (auto &it : directories) { fs::internal::closeHandle(it.second); } });
+        std::vector<PendingWrite> pending(files.size());
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            auto &it = pending[i];
+            it.Name = files[i].Path.filename().string();
+            if (it.Name.empty())
+            {
+                return false;
+            }
+            auto parent = directories.emplace(files[i].Path.parent_path(), -1).first;
+            if (parent->second < 0)
+            {
+                parent->second = openParentEx(files[i].Path);
+                if (parent->second < 0)
+                {
+                    return false;
+                }
+            }
+            it.DirHandle = parent->second;
+            it.Data      = files[i].Data.data();
+            it.Size      = files[i].Data.size();
+        }
+
+        std::atomic<bool> failed { false };
+        {
+            fs::internal::WorkStealingPool pool(std::min<unsigned>(fs::internal::threadCount(options.Threads),
+                                                                   static_cast<unsigned>(std::max<std::size_t>(pending.size(), 1))));
+            for (auto &it : pending)
+            {
+                pool.spawn([&] { if (!prepareEx(it, options)) { failed = true; } });
+            }
+            pool.wait();
+        }
+        if (failed)
+        {
+            for (const auto &it : pending)
+            {
+                if (it.Ready)
+                {
+                    unlinkat(it.DirHandle, it.TempName.c_str(), 0);
+                }
+            }
+            return false;
+        }
+
+        bool result = true;
+        for (const auto &it : pending)
+        {
+            result &= commitEx(it);
+        }
+        if (options.SyncDirectory)
+        {
+            for (const auto &it : directories)
+            {
+                result &= fsync(it.second) == 0;
+            }
+        }
+        return result;
+    }
+}
+#endif
@@ -0,0 +1,178 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <unordered_map>
+
+namespace
+{
+    // Files sharing a parent directory, opened once for all of them
+    struct DirGroup
+    {
+        int                         Handle  = -1;
+        int                         Error   = 0;
+        std::vector<std::size_t>    Files;
+    };
+
+    // Groups paths by parent, names[i] is what gets passed to openat
+    std::vector<DirGroup> groupByDirectory(const std::size_t count, const std::function<const fs::path &(std::size_t)> &pathAt,
+                                           std::vector<std::string> &names)
+    {
+        std::vector<DirGroup> groups;
+        std::unordered_map<std::string, std::size_t> known;
+        names.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const fs::path &file_path = pathAt(i);
+            names[i] = file_path.filename().native();
+            const auto parent = file_path.parent_path().native();
+            const auto found  = known.emplace(parent, groups.size());
+            if (found.second)
+            {
+                groups.emplace_back();
+                auto &group  = groups.back();
+                group.Handle = open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                group.Error  = group.Handle < 0 ? errno : 0;
+            }
+            groups[found.first->second].Files.push_back(i);
+        }
+        return groups;
+    }
+
+    void readEntry(const int dirHandle, const std::string &name, fs::io_result &result)
+    {
+        int file_handle = openat(dirHandle, name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_handle < 0)
+        {
+            result.Error = errno;
+            return;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        struct stat stats;
+        if (fstat(file_handle, &stats) != 0)
+        {
+            result.Error = errno;
+            return;
+        }
+        if (S_ISDIR(stats.st_mode))
+        {
+            result.Error = EISDIR;
+            return;
+        }
+        if (!fs::internal::readHandle(file_handle, stats, result.Data))
+        {
+            result.Error = errno;
+            return;
+        }
+        result.Transferred = result.Data.size();
+        result.Success     = true;
+    }
+
+    void writeEntry(const int dirHandle, const std::string &name, const fs::io_request &request, const fs::sync_policy sync, fs::io_result &result)
+    {
+        if (request.Op == fs::io_op::read)
+        {
+            result.Error = EINVAL;
+            return;
+        }
+        const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (request.Op == fs::io_op::append ? O_APPEND : O_TRUNC);
+        int file_handle = openat(dirHandle, name.c_str(), flags, 0666);
+        if (file_handle < 0)
+        {
+            result.Error = errno;
+            return;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        if (!fs::internal::writeFull(file_handle, request.Data.data(), request.Data.size()))
+        {
+            result.Error = errno;
+            return;
+        }
+        const bool synced = sync == fs::sync_policy::none ||
+                           (sync == fs::sync_policy::data ? fdatasync(file_handle) : fsync(file_handle)) == 0;
+        if (!synced)
+        {
+            result.Error = errno;
+            return;
+        }
+        result.Transferred = request.Data.size();
+        result.Success     = true;
+    }
+
+    // Runs work(group handle, file index) over every file, a task per FilesPerTask files of one directory
+    void runGrouped(std::vector<DirGroup> &groups, std::vector<fs::io_result> &results, const fs::batch_options &options,
+                    const std::function<void(const int, const std::size_t)> &work)
+    {
+        MakeScopeGuard([&] { for (auto &it : groups) { fs::internal::closeHandle(it.Handle); } });
+        const std::size_t per_task = std::max<std::size_t>(options.FilesPerTask, 1);
+        std::size_t tasks = 0;
+        for (auto &group : groups)
+        {
+            if (group.Handle < 0)
+            {
+                for (const auto index : group.Files)
+                {
+                    results[index].Error = group.Error;
+                }
+                continue;
+            }
+            tasks += (group.Files.size() + per_task - 1) / per_task;
+        }
+        if (tasks == 0)
+        {
+            return;
+        }
+        fs::internal::WorkStealingPool pool(std::min<unsigned>(fs::internal::threadCount(options.Threads), static_cast<unsigned>(tasks)));
+        for (auto &group : groups)
+        {
+            if (group.Handle < 0)
+            {
+                continue;
+            }
+            for (std::size_t first = 0; first < group.Files.size(); first += per_task)
+            {
+                const std::size_t last = std::min(first + per_task, group.Files.size());
+                pool.spawn([&group, &work, first, last]
+                {
+                    for (std::size_t i = first; i < last; ++i)
+                    {
+                        work(group.Handle, group.Files[i]);
+                    }
+                });
+            }
+        }
+        pool.wait();
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    std::vector<fs::io_result> readFiles(const std::vector<fs::path> &paths, const fs::batch_options &options)
+    {
+        std::vector<fs::io_result> results(paths.size());
+        std::vector<std::string> names;
+        auto groups = groupByDirectory(paths.size(), [&](const std::size_t i) -> const fs::path & { return paths[i]; }, names);
+        runGrouped(groups, results, options, [&](const int dirHandle, const std::size_t index)
+        {
+            readEntry(dirHandle, names[index], results[index]);
+        });
+        return results;
+    }
+
+    LIB_EXPORT
+    std::vector<fs::io_result> writeFiles(const std::vector<fs::io_request> &requests, const fs::batch_options &options)
+    {
+        std::vector<fs::io_result> results(requests.size());
+        std::vector<std::string> names;
+        auto groups = groupByDirectory(requests.size(), [&](const std::size_t i) -> const fs::path & { return requests[i].Path; }, names);
+        runGrouped(groups, results, options, [&](const int dirHandle, const std::size_t index)
+        {
+            writeEntry(dirHandle, names[index], requests[index], options.Sync, results[index]);
+        });
+        return results;
+    }
+}
+#endif
@@ -0,0 +1,136 @@
+#include "FsLib.h"
+
+#include <cstring>
+
+namespace fs
+{
+    ReadBuffer::ReadBuffer(ReadBuffer &&other) noexcept
+        : m_storage(std::move(other.m_storage)), m_size(other.m_size), m_capacity(other.m_capacity)
+    {
+        other.m_size     = 0;
+        other.m_capacity = 0;
+    }
+
+    ReadBuffer &ReadBuffer::operator=(ReadBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            m_storage        = std::move(other.m_storage);
+            m_size           = other.m_size;
+            m_capacity       = other.m_capacity;
+            other.m_size     = 0;
+            other.m_capacity = 0;
+        }
+        return *this;
+    }
+
+    void ReadBuffer::reserve(const std::size_t capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+        // new T[] of a trivial type is default-initialized, no zero fill
+        std::unique_ptr<std::byte[]> storage(new std::byte[capacity]);
+        if (m_size)
+        {
+            std::memcpy(storage.get(), m_storage.get(), m_size);
+        }
+        m_storage  = std::move(storage);
+        m_capacity = capacity;
+    }
+
+    void ReadBuffer::resizeForOverwrite(const std::size_t size)
+    {
+        if (size > m_capacity)
+        {
+            // Geometric growth so a sequence of slightly bigger files doesn't realloc every time
+            reserve(std::max(size, m_capacity + m_capacity / 2));
+        }
+        m_size = size;
+    }
+
+    void ReadBuffer::release()
+    {
+        m_storage.reset();
+        m_size     = 0;
+        m_capacity = 0;
+    }
+
+    BufferPool::Lease::Lease(Lease &&other) noexcept
+        : m_pool(other.m_pool), m_buffer(std::move(other.m_buffer))
+    {
+        other.m_pool = nullptr;
+    }
+
+    BufferPool::Lease &BufferPool::Lease::operator=(Lease &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_pool)
+            {
+                m_pool->giveBack(std::move(m_buffer));
+            }
+            m_pool       = other.m_pool;
+            m_buffer     = std::move(other.m_buffer);
+            other.m_pool = nullptr;
+        }
+        return *this;
+    }
+
+    BufferPool::Lease::~Lease()
+    {
+        if (m_pool)
+        {
+            m_pool->giveBack(std::move(m_buffer));
+        }
+    }
+
+    BufferPool::BufferPool(const std::size_t maxBuffers, const std::size_t maxRetainedCapacity)
+        : m_maxBuffers(maxBuffers), m_maxRetainedCapacity(maxRetainedCapacity)
+    {
+    }
+
+    BufferPool::Lease BufferPool::acquire(const std::size_t capacityHint)
+    {
+        ReadBuffer buffer;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (!m_free.empty())
+            {
+                // Prefer a buffer that is already big enough
+                auto it = std::find_if(m_free.begin(), m_free.end(),
+                    [&](const ReadBuffer &item) { return item.capacity() >= capacityHint; });
+                if (it == m_free.end())
+                {
+                    it = std::prev(m_free.end());
+                }
+                buffer = std::move(*it);
+                m_free.erase(it);
+            }
+        }
+        buffer.clear();
+        buffer.reserve(capacityHint);
+        return Lease(this, std::move(buffer));
+    }
+
+    void BufferPool::trim()
+    {
+        std::vector<ReadBuffer> dropped;
+        std::lock_guard<std::mutex> lock(m_lock);
+        dropped.swap(m_free);
+    }
+
+    void BufferPool::giveBack(ReadBuffer &&buffer)
+    {
+        if (buffer.capacity() == 0 || buffer.capacity() > m_maxRetainedCapacity)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_free.size() < m_maxBuffers)
+        {
+            m_free.push_back(std::move(buffer));
+        }
+    }
+}
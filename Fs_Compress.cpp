@@ -0,0 +1,899 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <cstring>
+
+namespace
+{
+    // LZ4 block format: sequences of (token, literals, 16-bit distance, match
+    // length), the token holding 4 bits of each length and 15 meaning "more
+    // bytes follow". Blocks are independent, no dictionary is carried over.
+    constexpr std::size_t   min_match       = 4;
+    constexpr std::size_t   last_literals   = 5;        // a block ends with at least this many literals
+    constexpr std::size_t   match_limit     = 12;       // no match starts closer to the end than this
+    constexpr std::size_t   max_distance    = 65535;
+    constexpr unsigned      hash_bits       = 12;
+
+    uint32_t load32(const uint8_t *src)
+    {
+        uint32_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash4(const uint32_t value)
+    {
+        return (value * 2654435761u) >> (32 - hash_bits);
+    }
+
+    uint8_t *putLength(uint8_t *dst, std::size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            *dst++ = 255;
+        }
+        *dst++ = static_cast<uint8_t>(length);
+        return dst;
+    }
+
+    // Compressed size, 0 when the result doesn't fit in capacity
+    std::size_t compressBlock(const uint8_t *src, const std::size_t size, uint8_t *dst, const std::size_t capacity, const int acceleration)
+    {
+        uint8_t *out            = dst;
+        uint8_t *const out_end  = dst + capacity;
+        std::size_t anchor      = 0;
+
+        // Literals [anchor, literalsEnd) and a match, the last sequence has literals only (length 0)
+        auto emit = [&](const std::size_t literalsEnd, const std::size_t length, const std::size_t distance)
+        {
+            const std::size_t literals = literalsEnd - anchor;
+            if (static_cast<std::size_t>(out_end - out) < 1 + literals / 255 + 1 + literals + 2 + length / 255 + 1)
+            {
+                return false;
+            }
+            uint8_t *token = out++;
+            *token = static_cast<uint8_t>(std::min<std::size_t>(literals, 15) << 4);
+            if (literals >= 15)
+            {
+                out = putLength(out, literals - 15);
+            }
+            std::memcpy(out, src + anchor, literals);
+            out += literals;
+            if (length == 0)
+            {
+                return true;
+            }
+            *out++ = static_cast<uint8_t>(distance);
+            *out++ = static_cast<uint8_t>(distance >> 8);
+            const std::size_t extra = length - min_match;
+            *token |= static_cast<uint8_t>(std::min<std::size_t>(extra, 15));
+            if (extra >= 15)
+            {
+                out = putLength(out, extra - 15);
+            }
+            return true;
+        };
+
+        if (size > match_limit)
+        {
+            uint32_t table[1u << hash_bits] = {};       // position + 1, 0 is empty
+            const std::size_t limit     = size - match_limit;
+            const std::size_t match_end = size - last_literals;
+            std::size_t pos = 0;
+            while (pos <= limit)
+            {
+                // Misses make the step grow, incompressible data is skipped through quickly
+                std::size_t ref      = 0;
+                std::size_t attempts = static_cast<std::size_t>(acceleration) << 6;
+                bool found = false;
+                while (pos <= limit)
+                {
+                    const uint32_t sequence = load32(src + pos);
+                    uint32_t &slot = table[hash4(sequence)];
+                    const std::size_t candidate = slot;
+                    slot = static_cast<uint32_t>(pos + 1);
+                    if (candidate != 0 && pos - (candidate - 1) <= max_distance && load32(src + candidate - 1) == sequence)
+                    {
+                        ref   = candidate - 1;
+                        found = true;
+                        break;
+                    }
+                    pos += attempts++ >> 6;
+                }
+                if (!found)
+                {
+                    break;
+                }
+                while (pos > anchor && ref > 0 && src[pos - 1] == src[ref - 1])
+                {
+                    --pos;
+                    --ref;
+                }
+                std::size_t length = min_match;
+                while (pos + length < match_end && src[pos + length] == src[ref + length])
+                {
+                    ++length;
+                }
+                if (!emit(pos, length, pos - ref))
+                {
+                    return 0;
+                }
+                pos   += length;
+                anchor = pos;
+                if (pos <= limit)
+                {
+                    table[hash4(load32(src + pos - 2))] = static_cast<uint32_t>(pos - 1);
+                }
+            }
+        }
+        if (!emit(size, 0, 0))
+        {
+            return 0;
+        }
+        return static_cast<std::size_t>(out - dst);
+    }
+
+    // False on anything that doesn't decode into exactly capacity bytes
+    bool decompressBlock(const uint8_t *src, const std::size_t size, uint8_t *dst, const std::size_t capacity)
+    {
+        std::size_t in  = 0,
+                    out = 0;
+        auto getLength = [&](std::size_t &length)
+        {
+            uint8_t next = 255;
+            while (next == 255)
+            {
+                if (in >= size)
+                {
+                    return false;
+                }
+                next    = src[in++];
+                length += next;
+            }
+            return true;
+        };
+
+        while (in < size)
+        {
+            const uint8_t token = src[in++];
+            std::size_t literals = token >> 4;
+            if ((literals == 15 && !getLength(literals)) || literals > size - in || literals > capacity - out)
+            {
+                return false;
+            }
+            std::memcpy(dst + out, src + in, literals);
+            in  += literals;
+            out += literals;
+            if (in == size)
+            {
+                break;
+            }
+            if (size - in < 2)
+            {
+                return false;
+            }
+            const std::size_t distance = src[in] | static_cast<std::size_t>(src[in + 1]) << 8;
+            in += 2;
+            std::size_t length = token & 15;
+            if (distance == 0 || distance > out || (length == 15 && !getLength(length)))
+            {
+                return false;
+            }
+            length += min_match;
+            if (length > capacity - out)
+            {
+                return false;
+            }
+            // Overlapping matches repeat the last distance bytes, those go byte by byte
+            if (distance >= length)
+            {
+                std::memcpy(dst + out, dst + out - distance, length);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < length; ++i)
+                {
+                    dst[out + i] = dst[out + i - distance];
+                }
+            }
+            out += length;
+        }
+        return out == capacity;
+    }
+
+    // Frame: header | blocks | index | footer, all little endian.
+    // Header is magic + reserved word, an index entry is (u64 offset, u32 size
+    // with stored_flag, u32 raw size), the footer (u64 index offset, u64 block
+    // count, u64 raw size, magic, reserved word).
+    constexpr char          frame_magic[4]  = { 'F', 'S', 'Z', '1' };
+    constexpr char          index_magic[4]  = { 'F', 'S', 'Z', 'I' };
+    constexpr std::size_t   header_size     = 8;
+    constexpr std::size_t   entry_size      = 16;
+    constexpr std::size_t   footer_size     = 32;
+    constexpr uint32_t      stored_flag     = 0x80000000u;
+    constexpr std::size_t   min_block       = 4096;
+    constexpr std::size_t   max_block       = 1u << 30;
+
+    struct BlockEntry
+    {
+        uint64_t    Offset      = 0;        // in the file
+        uint64_t    RawOffset   = 0;        // in the uncompressed data
+        uint32_t    Size        = 0;
+        uint32_t    RawSize     = 0;
+        bool        Stored      = false;
+    };
+
+    void putLe(uint8_t *dst, const uint64_t value, const std::size_t bytes)
+    {
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+            dst[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    uint64_t getLe(const uint8_t *src, const std::size_t bytes)
+    {
+        uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+            value |= static_cast<uint64_t>(src[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    // Reads and checks the index of a frame of fileSize bytes: blocks must come
+    // in order between the header and the index without overlapping, and add up
+    // to the raw size. Gaps between blocks are allowed.
+    bool loadIndex(const int fileHandle, const uint64_t fileSize, std::vector<BlockEntry> &index, uint64_t &rawSize, uint64_t &indexOffset)
+    {
+        uint8_t header[header_size],
+                footer[footer_size];
+        std::size_t read_bytes = 0;
+        if (fileSize < header_size + footer_size ||
+            !fs::internal::preadFull(fileHandle, header, header_size, 0, read_bytes) || read_bytes != header_size ||
+            !fs::internal::preadFull(fileHandle, footer, footer_size, fileSize - footer_size, read_bytes) || read_bytes != footer_size ||
+            std::memcmp(header, frame_magic, sizeof(frame_magic)) != 0 || std::memcmp(footer + 24, index_magic, sizeof(index_magic)) != 0)
+        {
+            return false;
+        }
+        indexOffset = getLe(footer, 8);
+        rawSize     = getLe(footer + 16, 8);
+        const uint64_t count = getLe(footer + 8, 8);
+        if (indexOffset < header_size || indexOffset > fileSize - footer_size || (fileSize - footer_size - indexOffset) / entry_size != count ||
+            (fileSize - footer_size - indexOffset) % entry_size != 0)
+        {
+            return false;
+        }
+        fs::ReadBuffer entries(static_cast<std::size_t>(count * entry_size));
+        entries.resizeForOverwrite(static_cast<std::size_t>(count * entry_size));
+        if (!fs::internal::preadFull(fileHandle, entries.data(), entries.size(), indexOffset, read_bytes) || read_bytes != entries.size())
+        {
+            return false;
+        }
+        index.clear();
+        index.reserve(static_cast<std::size_t>(count));
+        uint64_t offset     = header_size,
+                 raw_offset = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto *src = reinterpret_cast<const uint8_t *>(entries.data()) + i * entry_size;
+            BlockEntry entry;
+            const uint32_t size = static_cast<uint32_t>(getLe(src + 8, 4));
+            entry.Offset    = getLe(src, 8);
+            entry.RawOffset = raw_offset;
+            entry.Size      = size & ~stored_flag;
+            entry.RawSize   = static_cast<uint32_t>(getLe(src + 12, 4));
+            entry.Stored    = (size & stored_flag) != 0;
+            if (entry.Offset < offset || entry.RawSize == 0 || entry.RawSize > max_block || (entry.Stored && entry.Size != entry.RawSize))
+            {
+                return false;
+            }
+            offset      = entry.Offset + entry.Size;
+            raw_offset += entry.RawSize;
+            index.push_back(entry);
+        }
+        return offset <= indexOffset && raw_offset == rawSize;
+    }
+
+    // Block contents into dst (entry.RawSize bytes), packed is scratch for the compressed bytes
+    bool decodeBlock(const int fileHandle, const BlockEntry &entry, fs::ReadBuffer &packed, uint8_t *dst)
+    {
+        std::size_t read_bytes = 0;
+        if (entry.Stored)
+        {
+            return fs::internal::preadFull(fileHandle, dst, entry.RawSize, entry.Offset, read_bytes) && read_bytes == entry.RawSize;
+        }
+        packed.resizeForOverwrite(entry.Size);
+        return fs::internal::preadFull(fileHandle, packed.data(), entry.Size, entry.Offset, read_bytes) && read_bytes == entry.Size &&
+               decompressBlock(reinterpret_cast<const uint8_t *>(packed.data()), entry.Size, dst, entry.RawSize);
+    }
+}
+
+namespace fs
+{
+    struct CompressedWriter::Impl
+    {
+        explicit Impl(const compress_options &options)
+            : Options(options),
+              Threads(fs::internal::threadCount(options.Threads))
+        {
+            Options.BlockSize    = std::min(std::max(Options.BlockSize, min_block), max_block);
+            Options.Acceleration = std::max(Options.Acceleration, 1);
+        }
+
+        ~Impl()
+        {
+            fs::internal::closeHandle(Handle);
+        }
+
+        bool compress(const uint8_t *src, const std::size_t size);
+        bool finish();
+        void restore();
+
+        compress_options                                    Options;
+        const unsigned                                      Threads;
+        int                                                 Handle      = -1;
+        uint64_t                                            Offset      = header_size;  // where the next block goes
+        uint64_t                                            KeptOffset  = 0;    // appending: where the old index was,
+        fs::ReadBuffer                                      KeptTail;           // and it with the old footer, put back on failure
+        uint64_t                                            RawSize     = 0;
+        uint64_t                                            Written     = 0;
+        std::vector<BlockEntry>                             Index;
+        fs::ReadBuffer                                      Pending;
+        std::vector<fs::ReadBuffer>                         Packed;
+        std::vector<std::size_t>                            Sizes;
+        std::unique_ptr<fs::internal::WorkStealingPool>     Pool;       // made on the first batch worth it
+        bool                                                Failed      = false;
+    };
+
+    // Cuts [src, src + size) into blocks, compresses them (a window of them at a
+    // time in parallel) and writes them out in order
+    bool CompressedWriter::Impl::compress(const uint8_t *src, const std::size_t size)
+    {
+        const std::size_t window = std::max<std::size_t>(Threads * 2u, 1);
+        for (std::size_t done = 0; done < size;)
+        {
+            const std::size_t blocks = std::min(window, (size - done + Options.BlockSize - 1) / Options.BlockSize);
+            if (Packed.size() < blocks)
+            {
+                Packed.resize(blocks);
+                Sizes.resize(blocks);
+            }
+            auto work = [this, src, done, size](const std::size_t i)
+            {
+                const std::size_t start = done + i * Options.BlockSize;
+                const std::size_t raw   = std::min(Options.BlockSize, size - start);
+                Packed[i].resizeForOverwrite(raw);
+                // Stored as is unless compression saves something
+                Sizes[i] = compressBlock(src + start, raw, reinterpret_cast<uint8_t *>(Packed[i].data()), raw - 1, Options.Acceleration);
+            };
+            if (blocks > 1 && Threads > 1)
+            {
+                if (!Pool)
+                {
+                    Pool = std::make_unique<fs::internal::WorkStealingPool>(Threads);
+                }
+                for (std::size_t i = 0; i < blocks; ++i)
+                {
+                    Pool->spawn([&work, i] { work(i); });
+                }
+                Pool->wait();
+            }
+            else
+            {
+                for (std::size_t i = 0; i < blocks; ++i)
+                {
+                    work(i);
+                }
+            }
+            for (std::size_t i = 0; i < blocks; ++i)
+            {
+                const std::size_t raw = std::min(Options.BlockSize, size - done);
+                BlockEntry entry;
+                entry.Offset    = Offset;
+                entry.RawOffset = RawSize;
+                entry.Stored    = Sizes[i] == 0;
+                entry.Size      = static_cast<uint32_t>(entry.Stored ? raw : Sizes[i]);
+                entry.RawSize   = static_cast<uint32_t>(raw);
+                if (!fs::internal::pwriteFull(Handle, entry.Stored ? static_cast<const void *>(src + done) : Packed[i].data(), entry.Size, Offset))
+                {
+                    Failed = true;
+                    return false;
+                }
+                Offset  += entry.Size;
+                RawSize += raw;
+                done    += raw;
+                Index.push_back(entry);
+            }
+        }
+        return true;
+    }
+
+    // Last block, index and footer
+    bool CompressedWriter::Impl::finish()
+    {
+        if (Failed || (!Pending.empty() && !compress(reinterpret_cast<const uint8_t *>(Pending.data()), Pending.size())))
+        {
+            restore();
+            return false;
+        }
+        Pending.clear();
+        fs::ReadBuffer tail(Index.size() * entry_size + footer_size);
+        tail.resizeForOverwrite(Index.size() * entry_size + footer_size);
+        auto *dst = reinterpret_cast<uint8_t *>(tail.data());
+        for (const auto &it : Index)
+        {
+            putLe(dst, it.Offset, 8);
+            putLe(dst + 8, it.Size | (it.Stored ? stored_flag : 0), 4);
+            putLe(dst + 12, it.RawSize, 4);
+            dst += entry_size;
+        }
+        putLe(dst, Offset, 8);
+        putLe(dst + 8, Index.size(), 8);
+        putLe(dst + 16, RawSize, 8);
+        std::memcpy(dst + 24, index_magic, sizeof(index_magic));
+        putLe(dst + 28, 0, 4);
+        if (!fs::internal::pwriteFull(Handle, tail.data(), tail.size(), Offset) ||
+            ftruncate(Handle, static_cast<off_t>(Offset + tail.size())) != 0)
+        {
+            Failed = true;
+            restore();
+            return false;
+        }
+        return true;
+    }
+
+    // A failed append writes the old index and footer back over whatever blocks
+    // made it to the file, and cuts the file where it ended before
+    void CompressedWriter::Impl::restore()
+    {
+        if (!KeptTail.empty() && fs::internal::pwriteFull(Handle, KeptTail.data(), KeptTail.size(), KeptOffset))
+        {
+            [[maybe_unused]] const int res = ftruncate(Handle, static_cast<off_t>(KeptOffset + KeptTail.size()));
+        }
+    }
+
+    CompressedWriter::CompressedWriter() = default;
+
+    CompressedWriter::CompressedWriter(const fs::path &filePath, const bool append, const compress_options &options)
+    {
+        open(filePath, append, options);
+    }
+
+    CompressedWriter::CompressedWriter(CompressedWriter &&other) noexcept = default;
+
+    CompressedWriter &CompressedWriter::operator=(CompressedWriter &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_impl = std::move(other.m_impl);
+        }
+        return *this;
+    }
+
+    CompressedWriter::~CompressedWriter()
+    {
+        close();
+    }
+
+    bool CompressedWriter::open(const fs::path &filePath, const bool append, const compress_options &options)
+    {
+        close();
+        auto impl = std::make_unique<Impl>(options);
+        impl->Handle = ::open(filePath.c_str(), append ? O_RDWR | O_CREAT | O_CLOEXEC : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (impl->Handle < 0)
+        {
+            return false;
+        }
+        struct stat stats;
+        if (fstat(impl->Handle, &stats) != 0 || !S_ISREG(stats.st_mode))
+        {
+            return false;
+        }
+        if (stats.st_size > 0)
+        {
+            // New blocks go over the old index, finish() writes the merged one. The old
+            // index and footer are kept aside to put them back if the append fails.
+            uint64_t index_offset = 0;
+            if (!loadIndex(impl->Handle, static_cast<uint64_t>(stats.st_size), impl->Index, impl->RawSize, index_offset))
+            {
+                return false;
+            }
+            const std::size_t tail_size = static_cast<std::size_t>(static_cast<uint64_t>(stats.st_size) - index_offset);
+            std::size_t read_bytes = 0;
+            impl->KeptTail.resizeForOverwrite(tail_size);
+            if (!fs::internal::preadFull(impl->Handle, impl->KeptTail.data(), tail_size, index_offset, read_bytes) || read_bytes != tail_size)
+            {
+                return false;
+            }
+            impl->Offset     = index_offset;
+            impl->KeptOffset = index_offset;
+        }
+        else
+        {
+            uint8_t header[header_size] = {};
+            std::memcpy(header, frame_magic, sizeof(frame_magic));
+            if (!fs::internal::pwriteFull(impl->Handle, header, header_size, 0))
+            {
+                return false;
+            }
+        }
+        impl->Pending.reserve(impl->Options.BlockSize);
+        m_impl = std::move(impl);
+        return true;
+    }
+
+    bool CompressedWriter::close()
+    {
+        if (!m_impl)
+        {
+            return false;
+        }
+        const bool res = m_impl->finish();
+        m_impl.reset();
+        return res;
+    }
+
+    bool CompressedWriter::isOpen() const
+    {
+        return m_impl != nullptr;
+    }
+
+    bool CompressedWriter::failed() const
+    {
+        return m_impl && m_impl->Failed;
+    }
+
+    uint64_t CompressedWriter::written() const
+    {
+        return m_impl ? m_impl->Written : 0;
+    }
+
+    bool CompressedWriter::write(const void *data, const std::size_t size)
+    {
+        if (!m_impl || m_impl->Failed)
+        {
+            return false;
+        }
+        auto &impl = *m_impl;
+        const auto *src = static_cast<const uint8_t *>(data);
+        const std::size_t block = impl.Options.BlockSize;
+        std::size_t done = 0;
+        while (done < size)
+        {
+            if (impl.Pending.empty() && size - done >= block)
+            {
+                // Whole blocks straight from the caller's buffer
+                const std::size_t whole = (size - done) / block * block;
+                if (!impl.compress(src + done, whole))
+                {
+                    return false;
+                }
+                done += whole;
+                continue;
+            }
+            const std::size_t used = impl.Pending.size();
+            const std::size_t take = std::min(size - done, block - used);
+            impl.Pending.resizeForOverwrite(used + take);
+            std::memcpy(impl.Pending.data() + used, src + done, take);
+            done += take;
+            if (impl.Pending.size() == block)
+            {
+                if (!impl.compress(reinterpret_cast<const uint8_t *>(impl.Pending.data()), block))
+                {
+                    return false;
+                }
+                impl.Pending.clear();
+            }
+        }
+        impl.Written += size;
+        return true;
+    }
+
+    struct CompressedReader::Impl
+    {
+        ~Impl()
+        {
+            fs::internal::closeHandle(Handle);
+        }
+
+        // Block holding offset, offset < Size
+        std::size_t find(const uint64_t offset) const
+        {
+            const auto it = std::upper_bound(Index.begin(), Index.end(), offset,
+                                             [](const uint64_t value, const BlockEntry &entry) { return value < entry.RawOffset; });
+            return static_cast<std::size_t>(it - Index.begin()) - 1;
+        }
+
+        // Decodes a block into Block, the last one decoded is kept
+        bool load(const std::size_t block)
+        {
+            if (Cached == block)
+            {
+                return true;
+            }
+            Cached = Index.size();
+            Block.resizeForOverwrite(Index[block].RawSize);
+            if (!decodeBlock(Handle, Index[block], Packed, reinterpret_cast<uint8_t *>(Block.data())))
+            {
+                return false;
+            }
+            Cached = block;
+            return true;
+        }
+
+        int                         Handle  = -1;
+        uint64_t                    Size    = 0;
+        uint64_t                    Offset  = 0;
+        std::vector<BlockEntry>     Index;
+        fs::ReadBuffer              Packed;
+        fs::ReadBuffer              Block;
+        std::size_t                 Cached  = 0;    // Index.size() when nothing is
+    };
+
+    CompressedReader::CompressedReader() = default;
+
+    CompressedReader::CompressedReader(const fs::path &filePath)
+    {
+        open(filePath);
+    }
+
+    CompressedReader::CompressedReader(CompressedReader &&other) noexcept = default;
+
+    CompressedReader &CompressedReader::operator=(CompressedReader &&other) noexcept = default;
+
+    CompressedReader::~CompressedReader() = default;
+
+    bool CompressedReader::open(const fs::path &filePath)
+    {
+        close();
+        auto impl = std::make_unique<Impl>();
+        impl->Handle = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat stats;
+        uint64_t index_offset = 0;
+        if (impl->Handle < 0 || fstat(impl->Handle, &stats) != 0 || !S_ISREG(stats.st_mode) ||
+            !loadIndex(impl->Handle, static_cast<uint64_t>(stats.st_size), impl->Index, impl->Size, index_offset))
+        {
+            return false;
+        }
+        impl->Cached = impl->Index.size();
+        m_impl = std::move(impl);
+        return true;
+    }
+
+    void CompressedReader::close()
+    {
+        m_impl.reset();
+    }
+
+    bool CompressedReader::isOpen() const
+    {
+        return m_impl != nullptr;
+    }
+
+    uint64_t CompressedReader::size() const
+    {
+        return m_impl ? m_impl->Size : 0;
+    }
+
+    std::size_t CompressedReader::blockCount() const
+    {
+        return m_impl ? m_impl->Index.size() : 0;
+    }
+
+    uint64_t CompressedReader::offset() const
+    {
+        return m_impl ? m_impl->Offset : 0;
+    }
+
+    bool CompressedReader::eof() const
+    {
+        return !m_impl || m_impl->Offset >= m_impl->Size;
+    }
+
+    bool CompressedReader::seek(const uint64_t offset)
+    {
+        if (!m_impl || offset > m_impl->Size)
+        {
+            return false;
+        }
+        m_impl->Offset = offset;
+        return true;
+    }
+
+    bool CompressedReader::read(const uint64_t offset, const std::size_t length, fs::ReadBuffer &data)
+    {
+        data.clear();
+        if (!m_impl)
+        {
+            return false;
+        }
+        auto &impl = *m_impl;
+        if (offset >= impl.Size)
+        {
+            return true;
+        }
+        const std::size_t total = static_cast<std::size_t>(std::min<uint64_t>(length, impl.Size - offset));
+        data.resizeForOverwrite(total);
+        auto *dst = reinterpret_cast<uint8_t *>(data.data());
+        std::size_t done = 0;
+        for (std::size_t block = impl.find(offset); done < total; ++block)
+        {
+            const auto &entry = impl.Index[block];
+            const std::size_t inner = static_cast<std::size_t>(offset + done - entry.RawOffset);
+            const std::size_t take  = std::min<std::size_t>(entry.RawSize - inner, total - done);
+            // Fully covered blocks decode in place, the edges go through the block cache
+            if (take == entry.RawSize)
+            {
+                if (!decodeBlock(impl.Handle, entry, impl.Packed, dst + done))
+                {
+                    data.clear();
+                    return false;
+                }
+            }
+            else
+            {
+                if (!impl.load(block))
+                {
+                    data.clear();
+                    return false;
+                }
+                std::memcpy(dst + done, impl.Block.data() + inner, take);
+            }
+            done += take;
+        }
+        return true;
+    }
+
+    bool CompressedReader::readAll(fs::ReadBuffer &data, const unsigned threads)
+    {
+        data.clear();
+        if (!m_impl)
+        {
+            return false;
+        }
+        auto &impl = *m_impl;
+        const unsigned workers = fs::internal::threadCount(threads);
+        if (workers == 1 || impl.Index.size() < 2)
+        {
+            return read(0, static_cast<std::size_t>(impl.Size), data);
+        }
+        data.resizeForOverwrite(static_cast<std::size_t>(impl.Size));
+        auto *dst = reinterpret_cast<uint8_t *>(data.data());
+        std::atomic<bool> ok { true };
+        {
+            fs::internal::WorkStealingPool pool(std::min<unsigned>(workers, static_cast<unsigned>(impl.Index.size())));
+            for (const auto &it : impl.Index)
+            {
+                pool.spawn([&impl, &ok, &it, dst]
+                {
+                    thread_local fs::ReadBuffer packed;
+                    if (ok.load(std::memory_order_relaxed) && !decodeBlock(impl.Handle, it, packed, dst + it.RawOffset))
+                    {
+                        ok.store(false, std::memory_order_relaxed);
+                    }
+                });
+            }
+            pool.wait();
+        }
+        if (!ok.load())
+        {
+            data.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool CompressedReader::nextChunk(std::string_view &chunk)
+    {
+        chunk = {};
+        if (eof())
+        {
+            return false;
+        }
+        auto &impl = *m_impl;
+        const std::size_t block = impl.find(impl.Offset);
+        if (!impl.load(block))
+        {
+            return false;
+        }
+        const std::size_t inner = static_cast<std::size_t>(impl.Offset - impl.Index[block].RawOffset);
+        chunk = impl.Block.view().substr(inner);
+        impl.Offset += chunk.size();
+        return true;
+    }
+
+#if defined IS_CPP_20G
+    bool CompressedReader::nextChunk(std::span<const std::byte> &chunk)
+    {
+        std::string_view view;
+        const bool res = nextChunk(view);
+        chunk = { reinterpret_cast<const std::byte *>(view.data()), view.size() };
+        return res;
+    }
+#endif
+}
+
+namespace
+{
+    bool writeFileCompressedEx(const fs::path &filePath, const void *data, const std::size_t size, const fs::compress_options &options, const bool append)
+    {
+        fs::CompressedWriter writer;
+        if (!writer.open(filePath, append, options))
+        {
+            return false;
+        }
+        const bool res = writer.write(data, size);
+        return writer.close() && res;
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool readFileCompressed(const fs::path &filePath, fs::ReadBuffer &data, const unsigned threads)
+    {
+        fs::CompressedReader reader;
+        if (!reader.open(filePath))
+        {
+            data.clear();
+            return false;
+        }
+        return reader.readAll(data, threads);
+    }
+
+    LIB_EXPORT
+    bool readRangeCompressed(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data)
+    {
+        fs::CompressedReader reader;
+        if (!reader.open(filePath))
+        {
+            data.clear();
+            return false;
+        }
+        return reader.read(offset, length, data);
+    }
+
+    LIB_EXPORT
+    bool writeFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, false);
+    }
+
+    LIB_EXPORT
+    bool writeFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, false);
+    }
+
+    LIB_EXPORT
+    bool appendFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, true);
+    }
+
+    LIB_EXPORT
+    bool appendFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, true);
+    }
+
+#if defined IS_CPP_20G
+    LIB_EXPORT
+    bool writeFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, false);
+    }
+
+    LIB_EXPORT
+    bool appendFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options)
+    {
+        return writeFileCompressedEx(filePath, data.data(), data.size(), options, true);
+    }
+#endif
+}
+#endif
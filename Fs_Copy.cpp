@@ -0,0 +1,366 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+
+namespace
+{
+    constexpr std::size_t copy_chunk_size = 1 << 20;
+
+    // Errors after which the next, more generic, copy method is worth a try
+    bool unsupportedCopy(const int error)
+    {
+        return error == EXDEV || error == ENOSYS || error == EINVAL || error == EOPNOTSUPP ||
+               error == ENOTSUP || error == EBADF || error == ETXTBSY;
+    }
+
+    // Kernel side copy, returns false only on a hard error. `copied` is the
+    // offset the next method has to carry on from.
+    bool copyRangeEx(const int src, const int dst, const uint64_t size, uint64_t &copied, bool &done)
+    {
+        while (copied < size)
+        {
+            loff_t in_off  = static_cast<loff_t>(copied),
+                   out_off = static_cast<loff_t>(copied);
+            const ssize_t res = copy_file_range(src, &in_off, dst, &out_off, std::min<uint64_t>(size - copied, copy_chunk_size * 64), 0);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return unsupportedCopy(errno);
+            }
+            if (res == 0)
+            {
+                // Source shrank while copying
+                break;
+            }
+            copied += static_cast<uint64_t>(res);
+        }
+        done = true;
+        return true;
+    }
+
+    bool sendFileEx(const int src, const int dst, const uint64_t size, uint64_t &copied, bool &done)
+    {
+        if (lseek(dst, static_cast<off_t>(copied), SEEK_SET) < 0)
+        {
+            return false;
+        }
+        while (copied < size)
+        {
+            off_t offset = static_cast<off_t>(copied);
+            const ssize_t res = sendfile(dst, src, &offset, std::min<uint64_t>(size - copied, copy_chunk_size * 64));
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return unsupportedCopy(errno);
+            }
+            if (res == 0)
+            {
+                break;
+            }
+            copied += static_cast<uint64_t>(res);
+        }
+        done = true;
+        return true;
+    }
+
+    bool bufferedCopyEx(const int src, const int dst, uint64_t &copied)
+    {
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[copy_chunk_size]);
+        while (true)
+        {
+            std::size_t read_bytes = 0;
+            if (!fs::internal::preadFull(src, buffer.get(), copy_chunk_size, copied, read_bytes))
+            {
+                return false;
+            }
+            if (read_bytes == 0)
+            {
+                return true;
+            }
+            if (!fs::internal::pwriteFull(dst, buffer.get(), read_bytes, copied))
+            {
+                return false;
+            }
+            copied += read_bytes;
+        }
+    }
+
+    // Opened source and destination, tries reflink, copy_file_range, sendfile
+    // and plain read / write in that order, each one picks up where the previous stopped
+    bool copyDataEx(const int src, const int dst, const struct stat &stats, const fs::copy_options &options)
+    {
+        if (options.Reflink != fs::clone_mode::never && ioctl(dst, FICLONE, src) == 0)
+        {
+            return true;
+        }
+        if (options.Reflink == fs::clone_mode::always)
+        {
+            return false;
+        }
+        const uint64_t size = static_cast<uint64_t>(stats.st_size);
+        uint64_t copied = 0;
+        bool done = false;
+        // Files in /proc and friends report zero size, only the read loop copies them right
+        if (size != 0)
+        {
+            if (!copyRangeEx(src, dst, size, copied, done))
+            {
+                return false;
+            }
+            if (!done && !sendFileEx(src, dst, size, copied, done))
+            {
+                return false;
+            }
+        }
+        if (!done || copied >= size)
+        {
+            // Also catches a source that grew after fstat
+            if (!bufferedCopyEx(src, dst, copied))
+            {
+                return false;
+            }
+        }
+        return ftruncate(dst, static_cast<off_t>(copied)) == 0;
+    }
+
+    bool applyAttributesEx(const int dst, const struct stat &stats, const fs::copy_options &options)
+    {
+        bool result = true;
+        if (options.PreserveMode)
+        {
+            // open / mkdir applied the umask, fchmod doesn't
+            result &= fchmod(dst, stats.st_mode & 07777) == 0;
+        }
+        if (options.PreserveTimes)
+        {
+            const struct timespec times[2] = { stats.st_atim, stats.st_mtim };
+            result &= futimens(dst, times) == 0;
+        }
+        return result;
+    }
+
+    // copyFile follows symlinks like cp does, copyTree handles links itself
+    bool copyFileEx(const int srcDir, const char *srcName, const int dstDir, const char *dstName, const fs::copy_options &options,
+                    const bool followLinks)
+    {
+        int src = openat(srcDir, srcName, O_RDONLY | O_CLOEXEC | (followLinks ? 0 : O_NOFOLLOW));
+        if (src < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(src); });
+        struct stat stats;
+        if (fstat(src, &stats) != 0 || !S_ISREG(stats.st_mode))
+        {
+            return false;
+        }
+        // No O_TRUNC: the destination may be the source itself or a hard link to it.
+        // copyFile writes through a destination symlink like cp, copyTree never leaves the tree.
+        const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (followLinks ? 0 : O_NOFOLLOW) | (options.Overwrite ? 0 : O_EXCL);
+        // A new file only takes the source's permissions when asked to, otherwise 0666 less the umask
+        int dst = openat(dstDir, dstName, flags, options.PreserveMode ? stats.st_mode & 0777 : 0666);
+        if (dst < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(dst); });
+        struct stat dst_stats;
+        if (fstat(dst, &dst_stats) != 0)
+        {
+            return false;
+        }
+        if (dst_stats.st_dev == stats.st_dev && dst_stats.st_ino == stats.st_ino)
+        {
+            errno = EINVAL;
+            return false;
+        }
+        if (ftruncate(dst, 0) != 0)
+        {
+            return false;
+        }
+        if (!copyDataEx(src, dst, stats, options))
+        {
+            return false;
+        }
+        return applyAttributesEx(dst, stats, options);
+    }
+
+    bool copySymlinkEx(const fs::path &from, const fs::path &to, const fs::copy_options &options)
+    {
+        std::string target(PATH_MAX, '\0');
+        const ssize_t res = readlink(from.c_str(), target.data(), target.size());
+        if (res < 0 || static_cast<std::size_t>(res) >= target.size())
+        {
+            return false;
+        }
+        target.resize(static_cast<std::size_t>(res));
+        if (symlink(target.c_str(), to.c_str()) == 0)
+        {
+            return true;
+        }
+        if (errno != EEXIST || !options.Overwrite)
+        {
+            return false;
+        }
+        struct stat stats;
+        // Never replace a directory with a link
+        if (lstat(to.c_str(), &stats) != 0 || S_ISDIR(stats.st_mode) || unlink(to.c_str()) != 0)
+        {
+            return false;
+        }
+        return symlink(target.c_str(), to.c_str()) == 0;
+    }
+
+    bool makeDirectoryEx(const fs::path &to, const struct stat &stats)
+    {
+        // Owner keeps write access until the content is copied, the real mode comes last
+        if (mkdir(to.c_str(), (stats.st_mode & 0777) | S_IRWXU) == 0)
+        {
+            return true;
+        }
+        struct stat existing;
+        return errno == EEXIST && lstat(to.c_str(), &existing) == 0 && S_ISDIR(existing.st_mode);
+    }
+
+    bool insideOf(const fs::path &child, const fs::path &parent)
+    {
+        std::error_code err;
+        const auto lhs = std::filesystem::weakly_canonical(child, err);
+        const auto rhs = std::filesystem::weakly_canonical(parent, err);
+        if (err)
+        {
+            return false;
+        }
+        auto it = lhs.begin();
+        for (const auto &part : rhs)
+        {
+            if (part.empty())
+            {
+                continue;
+            }
+            if (it == lhs.end() || *it != part)
+            {
+                return false;
+            }
+            ++it;
+        }
+        return true;
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool copyFile(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options)
+    {
+        return copyFileEx(AT_FDCWD, fromPath.c_str(), AT_FDCWD, toPath.c_str(), options, true);
+    }
+
+    LIB_EXPORT
+    bool copyTree(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options)
+    {
+        struct stat root_stats;
+        if (stat(fromPath.c_str(), &root_stats) != 0 || !S_ISDIR(root_stats.st_mode))
+        {
+            return false;
+        }
+        // The walk would pick up what it just created
+        if (insideOf(toPath, fromPath))
+        {
+            return false;
+        }
+        if (!makeDirectoryEx(toPath, root_stats))
+        {
+            return false;
+        }
+
+        // Directory times have to be set after their content is in place
+        std::vector<std::pair<fs::path, struct stat>> directories;
+        directories.emplace_back(toPath, root_stats);
+        std::atomic<bool> failed { false };
+        fs::internal::WorkStealingPool pool(fs::internal::threadCount(options.Threads));
+        auto fail = [&]
+        {
+            failed = true;
+            if (options.StopOnError)
+            {
+                pool.cancel();
+            }
+        };
+
+        fs::walk_options walk_options;
+        walk_options.StopOnError = options.StopOnError;
+        // Directories are created here in pre-order, files go to the pool as soon
+        // as their parent exists
+        const bool walked = fs::posix::walk(fromPath, [&](const fs::walk_entry &entry)
+        {
+            if (options.StopOnError && failed)
+            {
+                return fs::walk_action::stop;
+            }
+            const auto relative = entry.path();
+            switch (entry.Type)
+            {
+            case fs::entry_type::directory:
+            {
+                const struct stat *stats = entry.stat();
+                if (!stats || !makeDirectoryEx(toPath / relative, *stats))
+                {
+                    fail();
+                    return options.StopOnError ? fs::walk_action::stop : fs::walk_action::skip;
+                }
+                directories.emplace_back(toPath / relative, *stats);
+                break;
+            }
+            case fs::entry_type::file:
+                pool.spawn([&, relative]
+                {
+                    if (!copyFileEx(AT_FDCWD, (fromPath / relative).c_str(), AT_FDCWD, (toPath / relative).c_str(), options, false))
+                    {
+                        fail();
+                    }
+                });
+                break;
+            case fs::entry_type::symlink:
+                if (!copySymlinkEx(fromPath / relative, toPath / relative, options))
+                {
+                    fail();
+                }
+                break;
+            default:
+                // Sockets, fifos and devices are not copied
+                break;
+            }
+            return options.StopOnError && failed ? fs::walk_action::stop : fs::walk_action::next;
+        }, walk_options);
+        pool.wait();
+
+        // Deepest first, so setting a child's times doesn't touch the parent again
+        for (auto it = directories.rbegin(); it != directories.rend(); ++it)
+        {
+            if (!options.PreserveMode && !options.PreserveTimes)
+            {
+                break;
+            }
+            int handle = open(it->first.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (handle < 0 || !applyAttributesEx(handle, it->second, options))
+            {
+                failed = true;
+            }
+            fs::internal::closeHandle(handle);
+        }
+        return walked && !failed;
+    }
+}
+#endif
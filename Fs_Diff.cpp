@@ -0,0 +1,507 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <limits.h>
+
+#include <deque>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+    // What the walk tells about an entry, enough to decide most of the diff without reading
+    struct TreeEntry
+    {
+        fs::entry_type  Type    = fs::entry_type::unknown;
+        uint64_t        Size    = 0;
+        int64_t         Mtime   = 0;
+        uint64_t        Device  = 0;
+        uint64_t        Inode   = 0;
+        std::string     Target;         // symlinks
+    };
+
+    using tree_entries = std::unordered_map<std::string, TreeEntry>;
+
+    // File whose content has to be looked at. Partial first, Full only for
+    // the ones the partial hash can't tell apart.
+    struct HashJob
+    {
+        fs::path    Path;
+        uint64_t    Size        = 0;
+        uint64_t    Partial     = 0;
+        uint64_t    Full        = 0;
+        bool        Complete    = false;    // the partial hash covered the whole file, Full is set
+        bool        Failed      = false;
+    };
+
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    bool collectEx(const fs::path &root, tree_entries &entries, const fs::compare_options &options, const bool filesOnly)
+    {
+        fs::walk_options walk_options;
+        walk_options.Filter = options.Filter;
+        bool result = true;
+        const bool walked = fs::posix::walk(root, [&](const fs::walk_entry &entry)
+        {
+            if (filesOnly && entry.Type != fs::entry_type::file)
+            {
+                return fs::walk_action::next;
+            }
+            TreeEntry item;
+            item.Type = entry.Type;
+            if (entry.Type == fs::entry_type::file)
+            {
+                const struct stat *stats = entry.stat();
+                if (!stats)
+                {
+                    result = false;
+                    return fs::walk_action::next;
+                }
+                item.Size   = static_cast<uint64_t>(stats->st_size);
+                item.Mtime  = nanoseconds(stats->st_mtim);
+                item.Device = stats->st_dev;
+                item.Inode  = stats->st_ino;
+            }
+            else if (entry.Type == fs::entry_type::symlink)
+            {
+                char target[PATH_MAX];
+                const ssize_t res = readlinkat(entry.DirHandle, entry.Name.data(), target, sizeof(target));
+                if (res < 0)
+                {
+                    result = false;
+                    return fs::walk_action::next;
+                }
+                item.Target.assign(target, static_cast<std::size_t>(res));
+            }
+            auto relative = entry.Parent.empty() ? std::string(entry.Name) : std::string(entry.Parent) + '/' + std::string(entry.Name);
+            entries.emplace(std::move(relative), std::move(item));
+            return fs::walk_action::next;
+        }, walk_options);
+        return walked && result;
+    }
+
+    bool partialHashEx(HashJob &job, const fs::compare_options &options)
+    {
+        const uint64_t part = options.PartialSize;
+        job.Complete = job.Size <= 2 * part;
+        if (!job.Complete && part == 0)
+        {
+            return true;
+        }
+        int handle = open(job.Path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        if (handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(handle); });
+        thread_local fs::ReadBuffer buffer;
+        const std::size_t length = static_cast<std::size_t>(job.Complete ? job.Size : 2 * part);
+        std::size_t head = 0,
+                    tail = 0;
+        buffer.resizeForOverwrite(length);
+        if (job.Complete)
+        {
+            if (!fs::internal::preadFull(handle, buffer.data(), length, 0, head))
+            {
+                return false;
+            }
+        }
+        else if (!fs::internal::preadFull(handle, buffer.data(), static_cast<std::size_t>(part), 0, head) ||
+                 !fs::internal::preadFull(handle, buffer.data() + part, static_cast<std::size_t>(part), job.Size - part, tail))
+        {
+            return false;
+        }
+        // A file that changed size since the walk has no meaningful hash
+        if (head + tail != length)
+        {
+            errno = ESTALE;
+            return false;
+        }
+        job.Partial = fs::Hasher::hash(options.Algorithm, buffer.data(), length);
+        if (job.Complete)
+        {
+            job.Full = job.Partial;
+        }
+        return true;
+    }
+
+    bool fullHashEx(HashJob &job, const fs::compare_options &options)
+    {
+        // Parallel over files already, one file keeps to one thread
+        fs::hash_options hash_options;
+        hash_options.Algorithm  = options.Algorithm;
+        hash_options.Threads    = 1;
+        return fs::posix::hashFile(job.Path, job.Full, hash_options);
+    }
+
+    // Hashes the jobs on a pool, false when any of them failed (those are marked)
+    bool hashJobsEx(const std::vector<HashJob *> &jobs, const bool full, const fs::compare_options &options)
+    {
+        if (jobs.empty())
+        {
+            return true;
+        }
+        std::atomic<bool> ok { true };
+        {
+            fs::internal::WorkStealingPool pool(static_cast<unsigned>(std::min<std::size_t>(fs::internal::threadCount(options.Threads), jobs.size())));
+            for (auto *job : jobs)
+            {
+                pool.spawn([&, job]
+                {
+                    if (!(full ? fullHashEx(*job, options) : partialHashEx(*job, options)))
+                    {
+                        job->Failed = true;
+                        ok.store(false, std::memory_order_relaxed);
+                    }
+                });
+            }
+            pool.wait();
+        }
+        return ok.load();
+    }
+
+    // Two jobs have the same content when their hashes agree at the level both reached
+    bool sameContent(const HashJob &lhs, const HashJob &rhs)
+    {
+        return !lhs.Failed && !rhs.Failed && lhs.Size == rhs.Size && lhs.Partial == rhs.Partial &&
+               (!lhs.Complete || !rhs.Complete || lhs.Full == rhs.Full);
+    }
+
+    struct PairHash
+    {
+        std::size_t operator()(const std::pair<uint64_t, uint64_t> &key) const
+        {
+            return std::hash<uint64_t>()(key.first * 0x9e3779b97f4a7c15ull ^ key.second);
+        }
+    };
+
+    using content_key = std::pair<uint64_t, uint64_t>;     // size, hash
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool diffTrees(const fs::path &oldPath, const fs::path &newPath, std::vector<fs::tree_change> &changes, const fs::compare_options &options)
+    {
+        changes.clear();
+        tree_entries old_entries,
+                     new_entries;
+        // The two walks are independent, usually on different disks
+        auto old_walk = std::async(std::launch::async, [&] { return collectEx(oldPath, old_entries, options, false); });
+        bool result = collectEx(newPath, new_entries, options, false);
+        result &= old_walk.get();
+
+        std::deque<HashJob> jobs;
+        std::vector<std::tuple<const std::string *, HashJob *, HashJob *>> pairs;     // same path on both sides, old / new
+        std::vector<const std::string *> added,
+                                         removed;
+        auto makeJob = [&](const fs::path &root, const std::string &relative, const TreeEntry &entry)
+        {
+            jobs.emplace_back();
+            jobs.back().Path = root / relative;
+            jobs.back().Size = entry.Size;
+            return &jobs.back();
+        };
+        auto report = [&](const fs::change_type type, const std::string &relative, const TreeEntry &entry)
+        {
+            fs::tree_change change;
+            change.Type = type;
+            change.Kind = entry.Type;
+            change.Path = relative;
+            change.Size = entry.Size;
+            changes.push_back(std::move(change));
+        };
+
+        for (const auto &[relative, entry] : new_entries)
+        {
+            const auto it = old_entries.find(relative);
+            if (it == old_entries.end())
+            {
+                added.push_back(&relative);
+                continue;
+            }
+            const TreeEntry &before = it->second;
+            if (before.Type != entry.Type)
+            {
+                report(fs::change_type::removed, relative, before);
+                report(fs::change_type::added, relative, entry);
+                continue;
+            }
+            if (entry.Type == fs::entry_type::symlink && before.Target != entry.Target)
+            {
+                report(fs::change_type::modified, relative, entry);
+            }
+            if (entry.Type != fs::entry_type::file)
+            {
+                continue;
+            }
+            if (before.Size != entry.Size)
+            {
+                report(fs::change_type::modified, relative, entry);
+                continue;
+            }
+            // Same inode is the same file, whatever the roots are called
+            if ((options.TrustMetadata && before.Mtime == entry.Mtime) ||
+                (before.Device == entry.Device && before.Inode == entry.Inode))
+            {
+                continue;
+            }
+            pairs.emplace_back(&relative, makeJob(oldPath, relative, before), makeJob(newPath, relative, entry));
+        }
+        for (const auto &[relative, entry] : old_entries)
+        {
+            if (new_entries.find(relative) == new_entries.end())
+            {
+                removed.push_back(&relative);
+            }
+        }
+
+        // Move candidates: files on both sides of the added / removed split with a size in common
+        std::vector<std::pair<const std::string *, HashJob *>> moved_from,
+                                                               moved_to;
+        if (options.DetectMoves && !added.empty() && !removed.empty())
+        {
+            std::unordered_map<uint64_t, unsigned> sizes;      // bit 0 - removed, bit 1 - added
+            for (const auto *relative : removed)
+            {
+                const TreeEntry &entry = old_entries[*relative];
+                if (entry.Type == fs::entry_type::file)
+                {
+                    sizes[entry.Size] |= 1;
+                }
+            }
+            for (const auto *relative : added)
+            {
+                const TreeEntry &entry = new_entries[*relative];
+                if (entry.Type == fs::entry_type::file)
+                {
+                    sizes[entry.Size] |= 2;
+                }
+            }
+            for (const auto *relative : removed)
+            {
+                const TreeEntry &entry = old_entries[*relative];
+                if (entry.Type == fs::entry_type::file && sizes[entry.Size] == 3)
+                {
+                    moved_from.emplace_back(relative, makeJob(oldPath, *relative, entry));
+                }
+            }
+            for (const auto *relative : added)
+            {
+                const TreeEntry &entry = new_entries[*relative];
+                if (entry.Type == fs::entry_type::file && sizes[entry.Size] == 3)
+                {
+                    moved_to.emplace_back(relative, makeJob(newPath, *relative, entry));
+                }
+            }
+        }
+
+        std::vector<HashJob *> pending;
+        for (auto &job : jobs)
+        {
+            pending.push_back(&job);
+        }
+        result &= hashJobsEx(pending, false, options);
+
+        // Full hashes only where the partial ones agree and didn't cover everything
+        pending.clear();
+        for (const auto &[relative, before, after] : pairs)
+        {
+            if (sameContent(*before, *after) && !before->Complete)
+            {
+                pending.push_back(before);
+                pending.push_back(after);
+            }
+        }
+        std::unordered_map<content_key, unsigned, PairHash> partials;       // bit 0 - removed, bit 1 - added
+        for (const auto &[relative, job] : moved_from)
+        {
+            partials[{ job->Size, job->Partial }] |= job->Failed ? 0 : 1;
+        }
+        for (const auto &[relative, job] : moved_to)
+        {
+            partials[{ job->Size, job->Partial }] |= job->Failed ? 0 : 2;
+        }
+        for (const auto *side : { &moved_from, &moved_to })
+        {
+            for (const auto &[relative, job] : *side)
+            {
+                if (!job->Failed && !job->Complete && partials[{ job->Size, job->Partial }] == 3)
+                {
+                    pending.push_back(job);
+                }
+            }
+        }
+        result &= hashJobsEx(pending, true, options);
+
+        for (const auto &[relative, before, after] : pairs)
+        {
+            // Unreadable files count as modified, a sync errs on the side of copying
+            if (!sameContent(*before, *after) || before->Full != after->Full)
+            {
+                report(fs::change_type::modified, *relative, new_entries[*relative]);
+            }
+        }
+
+        // Each removed file is the source of one move at most
+        std::unordered_map<content_key, std::vector<const std::string *>, PairHash> sources;
+        // Only the candidates that got a full hash can take part
+        auto hashed = [&](const HashJob &job)
+        {
+            return !job.Failed && (job.Complete || partials[{ job.Size, job.Partial }] == 3);
+        };
+        std::sort(moved_from.begin(), moved_from.end(), [](const auto &lhs, const auto &rhs) { return *lhs.first > *rhs.first; });
+        for (const auto &[relative, job] : moved_from)
+        {
+            if (hashed(*job))
+            {
+                sources[{ job->Size, job->Full }].push_back(relative);
+            }
+        }
+        std::unordered_set<const std::string *> moved;
+        std::sort(moved_to.begin(), moved_to.end(), [](const auto &lhs, const auto &rhs) { return *lhs.first < *rhs.first; });
+        for (const auto &[relative, job] : moved_to)
+        {
+            if (!hashed(*job))
+            {
+                continue;
+            }
+            auto it = sources.find({ job->Size, job->Full });
+            if (it == sources.end() || it->second.empty())
+            {
+                continue;
+            }
+            fs::tree_change change;
+            change.Type = fs::change_type::moved;
+            change.Path = *relative;
+            change.From = *it->second.back();
+            change.Size = job->Size;
+            changes.push_back(std::move(change));
+            moved.insert(relative);
+            moved.insert(it->second.back());
+            it->second.pop_back();
+        }
+        for (const auto *relative : added)
+        {
+            if (moved.find(relative) == moved.end())
+            {
+                report(fs::change_type::added, *relative, new_entries[*relative]);
+            }
+        }
+        for (const auto *relative : removed)
+        {
+            if (moved.find(relative) == moved.end())
+            {
+                report(fs::change_type::removed, *relative, old_entries[*relative]);
+            }
+        }
+
+        std::sort(changes.begin(), changes.end(), [](const fs::tree_change &lhs, const fs::tree_change &rhs)
+        {
+            return lhs.Path != rhs.Path ? lhs.Path < rhs.Path : lhs.Type < rhs.Type;
+        });
+        return result;
+    }
+
+    LIB_EXPORT
+    bool findDuplicates(const fs::path &Path, std::vector<std::vector<fs::path>> &groups, const fs::compare_options &options)
+    {
+        groups.clear();
+        tree_entries entries;
+        bool result = collectEx(Path, entries, options, true);
+
+        // Hard links to one inode are one file, they take no extra space
+        std::unordered_map<std::pair<uint64_t, uint64_t>, const std::string *, PairHash> inodes;      // device, inode
+        std::unordered_map<uint64_t, std::vector<const std::string *>> sizes;
+        for (const auto &[relative, entry] : entries)
+        {
+            if (entry.Size < options.MinSize)
+            {
+                continue;
+            }
+            auto &first = inodes[{ entry.Device, entry.Inode }];
+            if (!first || relative < *first)
+            {
+                first = &relative;
+            }
+        }
+        for (const auto &[inode, relative] : inodes)
+        {
+            sizes[entries[*relative].Size].push_back(relative);
+        }
+
+        std::deque<HashJob> jobs;
+        std::vector<HashJob *> pending;
+        for (const auto &[size, names] : sizes)
+        {
+            if (names.size() < 2)
+            {
+                continue;
+            }
+            for (const auto *relative : names)
+            {
+                jobs.emplace_back();
+                jobs.back().Path = Path / *relative;
+                jobs.back().Size = size;
+                pending.push_back(&jobs.back());
+            }
+        }
+        result &= hashJobsEx(pending, false, options);
+
+        std::unordered_map<content_key, std::vector<HashJob *>, PairHash> partials;
+        for (auto &job : jobs)
+        {
+            if (!job.Failed)
+            {
+                partials[{ job.Size, job.Partial }].push_back(&job);
+            }
+        }
+        pending.clear();
+        for (const auto &[key, candidates] : partials)
+        {
+            if (candidates.size() > 1 && !candidates.front()->Complete)
+            {
+                pending.insert(pending.end(), candidates.begin(), candidates.end());
+            }
+        }
+        result &= hashJobsEx(pending, true, options);
+
+        std::unordered_map<content_key, std::vector<HashJob *>, PairHash> fulls;
+        for (const auto &[key, candidates] : partials)
+        {
+            if (candidates.size() < 2)
+            {
+                continue;
+            }
+            for (auto *job : candidates)
+            {
+                if (!job->Failed)
+                {
+                    fulls[{ job->Size, job->Full }].push_back(job);
+                }
+            }
+        }
+        for (const auto &[key, candidates] : fulls)
+        {
+            if (candidates.size() < 2)
+            {
+                continue;
+            }
+            std::vector<fs::path> group;
+            for (const auto *job : candidates)
+            {
+                group.push_back(job->Path);
+            }
+            std::sort(group.begin(), group.end());
+            groups.push_back(std::move(group));
+        }
+        std::sort(groups.begin(), groups.end());
+        return result;
+    }
+}
+#endif
@@ -0,0 +1,187 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+namespace
+{
+    // Opened regular file (or anything but a directory) relative to dirHandle, -1 otherwise
+    int openAtEx(const int dirHandle, const fs::path &name, struct stat &stats)
+    {
+        int file_handle = openat(dirHandle, name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_handle >= 0 && (fstat(file_handle, &stats) != 0 || S_ISDIR(stats.st_mode)))
+        {
+            fs::internal::closeHandle(file_handle);
+        }
+        return file_handle;
+    }
+
+    bool readAtEx(const int dirHandle, const fs::path &name, fs::ReadBuffer &data)
+    {
+        struct stat stats;
+        int file_handle = openAtEx(dirHandle, name, stats);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        return fs::internal::readHandle(file_handle, stats, data);
+    }
+
+    // Straight into the container, sized from fstat; /proc entries and pipes are read until EOF
+    template<typename T>
+    bool readAtEx(const int dirHandle, const fs::path &name, T &data)
+    {
+        static_assert(sizeof(typename T::value_type) == 1, "byte containers only");
+        struct stat stats;
+        int file_handle = openAtEx(dirHandle, name, stats);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        const bool known_size = S_ISREG(stats.st_mode) && stats.st_size > 0;
+        std::size_t total = 0,
+                    chunk = 0;
+        data.resize(known_size ? static_cast<std::size_t>(stats.st_size) : 4096);
+        while (true)
+        {
+            if (!fs::internal::readFull(file_handle, reinterpret_cast<uint8_t *>(data.data()) + total, data.size() - total, chunk))
+            {
+                data.clear();
+                return false;
+            }
+            total += chunk;
+            if (known_size || total < data.size())
+            {
+                break;
+            }
+            data.resize(data.size() + std::max<std::size_t>(4096, data.size() / 2));
+        }
+        data.resize(total);
+        return true;
+    }
+
+    bool writeAtEx(const int dirHandle, const fs::path &name, const void *data, const std::size_t size, const bool append)
+    {
+        const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+        int file_handle = openat(dirHandle, name.c_str(), flags, 0666);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        return fs::internal::writeFull(file_handle, data, size);
+    }
+}
+
+namespace fs
+{
+    DirHandle::DirHandle(DirHandle &&other) noexcept
+        : m_handle(other.m_handle)
+    {
+        other.m_handle = -1;
+    }
+
+    DirHandle &DirHandle::operator=(DirHandle &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            std::swap(m_handle, other.m_handle);
+        }
+        return *this;
+    }
+
+    DirHandle::~DirHandle()
+    {
+        close();
+    }
+
+    bool DirHandle::open(const fs::path &Path)
+    {
+        close();
+        m_handle = ::open(Path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        return m_handle >= 0;
+    }
+
+    void DirHandle::close()
+    {
+        fs::internal::closeHandle(m_handle);
+    }
+
+    DirHandle DirHandle::openDir(const fs::path &name) const
+    {
+        DirHandle result;
+        result.m_handle = openat(m_handle, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        return result;
+    }
+
+    bool DirHandle::readFile(const fs::path &name, fs::ReadBuffer &data) const
+    {
+        return readAtEx(m_handle, name, data);
+    }
+
+    bool DirHandle::readFile(const fs::path &name, std::vector<uint8_t> &data) const
+    {
+        return readAtEx(m_handle, name, data);
+    }
+
+    bool DirHandle::readFile(const fs::path &name, std::string &data) const
+    {
+        return readAtEx(m_handle, name, data);
+    }
+
+    bool DirHandle::writeFile(const fs::path &name, std::string_view data) const
+    {
+        return writeAtEx(m_handle, name, data.data(), data.size(), false);
+    }
+
+    bool DirHandle::writeFile(const fs::path &name, const std::vector<uint8_t> &data) const
+    {
+        return writeAtEx(m_handle, name, data.data(), data.size(), false);
+    }
+
+    bool DirHandle::appendFile(const fs::path &name, std::string_view data) const
+    {
+        return writeAtEx(m_handle, name, data.data(), data.size(), true);
+    }
+
+    bool DirHandle::stat(const fs::path &name, struct stat &stats) const
+    {
+        return fstatat(m_handle, name.c_str(), &stats, 0) == 0;
+    }
+
+    bool DirHandle::isExist(const fs::path &name) const
+    {
+        struct stat stats;
+        return stat(name, stats);
+    }
+
+    bool DirHandle::isDirectory(const fs::path &name) const
+    {
+        struct stat stats;
+        return stat(name, stats) && S_ISDIR(stats.st_mode);
+    }
+
+    bool DirHandle::removeFile(const fs::path &name) const
+    {
+        return unlinkat(m_handle, name.c_str(), 0) == 0;
+    }
+
+    bool DirHandle::removeDir(const fs::path &name) const
+    {
+        return unlinkat(m_handle, name.c_str(), AT_REMOVEDIR) == 0;
+    }
+
+    bool DirHandle::createDirectory(const fs::path &name) const
+    {
+        if (mkdirat(m_handle, name.c_str(), 0777) == 0)
+        {
+            return true;
+        }
+        return errno == EEXIST && isDirectory(name);
+    }
+}
+#endif
@@ -0,0 +1,705 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <cstring>
+#include <deque>
+
+namespace
+{
+    // File layout: IndexHeader, Count IndexRecords sorted by path, the root
+    // path, then the path blob. Native layout so a mapping is usable as is,
+    // ByteOrder keeps a file from a host of the other endianness out.
+    constexpr char      index_magic[4]  = { 'F', 'S', 'D', 'X' };
+    constexpr uint32_t  index_version   = 1;
+    constexpr uint32_t  byte_order      = 0x01020304;
+
+    struct IndexHeader
+    {
+        char        Magic[4];
+        uint32_t    Version;
+        uint32_t    ByteOrder;
+        uint8_t     Hashed;
+        uint8_t     Algorithm;
+        uint8_t     Reserved[2];
+        uint64_t    Count;
+        uint64_t    NamesSize;
+        uint64_t    RootLength;
+        int64_t     RootTime;       // mtime of the root directory
+        uint8_t     Padding[16];
+    };
+
+    struct IndexRecord
+    {
+        uint64_t    NameOffset  = 0;    // into the path blob, the path is followed by a '\0'
+        uint32_t    NameLength  = 0;
+        uint8_t     Type        = 0;
+        uint8_t     Reserved[3] = {};
+        uint64_t    Size        = 0;
+        int64_t     ModifyTime  = 0;
+        uint64_t    Inode       = 0;    // a directory replaced by another one is walked again
+        uint64_t    Hash        = 0;
+    };
+
+    static_assert(sizeof(IndexHeader) == 64 && sizeof(IndexRecord) == 48, "DirIndex file layout changed");
+
+    // Entry on its way into the index, Path points into whatever storage still holds it
+    struct IndexItem
+    {
+        std::string_view    Path;
+        IndexRecord         Record;
+    };
+
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    IndexRecord fromStat(const struct stat &stats)
+    {
+        IndexRecord record;
+        record.Type         = static_cast<uint8_t>(fs::internal::modeType(stats.st_mode));
+        record.Size         = S_ISDIR(stats.st_mode) ? 0 : static_cast<uint64_t>(stats.st_size);
+        record.ModifyTime   = nanoseconds(stats.st_mtim);
+        record.Inode        = stats.st_ino;
+        return record;
+    }
+
+    bool isDirectory(const IndexRecord &record)
+    {
+        return record.Type == static_cast<uint8_t>(fs::entry_type::directory);
+    }
+
+    bool isFile(const IndexRecord &record)
+    {
+        return record.Type == static_cast<uint8_t>(fs::entry_type::file);
+    }
+
+    bool samePath(std::string_view path, std::string_view prefix)
+    {
+        return path.size() >= prefix.size() && path.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // Entries of a directory under the index root (relative "" for the root
+    // itself), stored into names / items with paths relative to the root
+    bool collectEx(const fs::path &root, const std::string &relative, const unsigned maxDepth, const fs::NameFilter &filter,
+                   std::deque<std::string> &names, std::vector<IndexItem> &items)
+    {
+        fs::walk_options walk_options;
+        walk_options.MaxDepth = maxDepth;
+        bool result = true;
+        const bool walked = fs::posix::walk(relative.empty() ? root : root / relative, [&](const fs::walk_entry &entry)
+        {
+            if (entry.Type != fs::entry_type::directory && !filter.matchesAll() && !filter.match(entry.Name))
+            {
+                return fs::walk_action::next;
+            }
+            const struct stat *stats = entry.stat();
+            if (!stats)
+            {
+                result = false;
+                return fs::walk_action::next;
+            }
+            std::string path = relative;
+            if (!path.empty())
+            {
+                path += '/';
+            }
+            if (!entry.Parent.empty())
+            {
+                path.append(entry.Parent.data(), entry.Parent.size()) += '/';
+            }
+            path.append(entry.Name.data(), entry.Name.size());
+            names.push_back(std::move(path));
+            items.push_back({ names.back(), fromStat(*stats) });
+            return fs::walk_action::next;
+        }, walk_options);
+        return walked && result;
+    }
+
+    // Fills Hash of the file items, on a pool
+    bool hashItemsEx(const fs::path &root, const std::vector<IndexItem *> &items, const fs::hash_algorithm algorithm, const unsigned threads)
+    {
+        if (items.empty())
+        {
+            return true;
+        }
+        std::atomic<bool> ok { true };
+        {
+            fs::internal::WorkStealingPool pool(fs::internal::threadCount(threads));
+            for (auto *item : items)
+            {
+                if (!isFile(item->Record))
+                {
+                    continue;
+                }
+                pool.spawn([&, record = &item->Record, path = item->Path]
+                {
+                    fs::hash_options options;
+                    options.Algorithm   = algorithm;
+                    options.Threads     = 1;
+                    if (!fs::posix::hashFile(root / std::string(path), record->Hash, options))
+                    {
+                        ok.store(false, std::memory_order_relaxed);
+                    }
+                });
+            }
+            pool.wait();
+        }
+        return ok.load();
+    }
+
+    void sortItems(std::vector<IndexItem> &items)
+    {
+        std::sort(items.begin(), items.end(), [](const IndexItem &lhs, const IndexItem &rhs) { return lhs.Path < rhs.Path; });
+    }
+}
+
+namespace fs
+{
+    struct DirIndex::Impl
+    {
+        std::string_view path(const IndexRecord &record) const
+        {
+            // Bounds are checked here rather than on load, a mapped index is never walked whole
+            if (record.NameOffset >= NamesSize || record.NameLength >= NamesSize - record.NameOffset)
+            {
+                return {};
+            }
+            return { Names + record.NameOffset, record.NameLength };
+        }
+
+        fs::index_entry entry(const std::size_t position) const
+        {
+            const IndexRecord &record = Records[position];
+            fs::index_entry result;
+            result.Path         = path(record);
+            result.Type         = static_cast<fs::entry_type>(record.Type);
+            result.Size         = record.Size;
+            result.ModifyTime   = record.ModifyTime;
+            result.Hash         = record.Hash;
+            return result;
+        }
+
+        // First record whose path isn't below key
+        std::size_t lowerBound(std::string_view key, const std::size_t from = 0) const
+        {
+            const auto *it = std::lower_bound(Records + from, Records + Count, key,
+                                              [this](const IndexRecord &record, std::string_view value) { return path(record) < value; });
+            return static_cast<std::size_t>(it - Records);
+        }
+
+        // Replaces the contents with the sorted items, which may point into the current storage
+        void assign(const std::vector<IndexItem> &items)
+        {
+            std::size_t names_size = 0;
+            for (const auto &item : items)
+            {
+                names_size += item.Path.size() + 1;
+            }
+            std::vector<IndexRecord> records;
+            std::string names;
+            records.reserve(items.size());
+            names.reserve(names_size);
+            for (const auto &item : items)
+            {
+                records.push_back(item.Record);
+                records.back().NameOffset = names.size();
+                records.back().NameLength = static_cast<uint32_t>(item.Path.size());
+                names.append(item.Path.data(), item.Path.size()) += '\0';
+            }
+            OwnRecords.swap(records);
+            OwnNames.swap(names);
+            Mapping.reset();
+            Records     = OwnRecords.data();
+            Count       = OwnRecords.size();
+            Names       = OwnNames.data();
+            NamesSize   = OwnNames.size();
+        }
+
+        fs::path                    Root;
+        int64_t                     RootTime    = 0;
+        bool                        Hashed      = false;
+        fs::hash_algorithm          Algorithm   = fs::hash_algorithm::xxh64;
+        // Built or refreshed indexes own their storage, loaded ones point into the mapping
+        std::vector<IndexRecord>    OwnRecords;
+        std::string                 OwnNames;
+        fs::MappedFile              Mapping;
+        const IndexRecord          *Records     = nullptr;
+        std::size_t                 Count       = 0;
+        const char                 *Names       = nullptr;
+        std::size_t                 NamesSize   = 0;
+    };
+
+    DirIndex::DirIndex() = default;
+
+    DirIndex::DirIndex(DirIndex &&other) noexcept = default;
+
+    DirIndex &DirIndex::operator=(DirIndex &&other) noexcept = default;
+
+    DirIndex::~DirIndex() = default;
+
+    bool DirIndex::build(const fs::path &Path, const dir_index_options &options)
+    {
+        clear();
+        auto impl = std::make_unique<Impl>();
+        std::error_code err;
+        impl->Root = std::filesystem::absolute(Path, err);
+        struct stat stats;
+        if (err || stat(impl->Root.c_str(), &stats) != 0 || !S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        impl->RootTime  = nanoseconds(stats.st_mtim);
+        impl->Hashed    = options.Hash;
+        impl->Algorithm = options.Algorithm;
+
+        std::deque<std::string> names;
+        std::vector<IndexItem> items;
+        bool result = collectEx(impl->Root, {}, 0, options.Filter, names, items);
+        if (impl->Hashed)
+        {
+            std::vector<IndexItem *> targets;
+            for (auto &item : items)
+            {
+                targets.push_back(&item);
+            }
+            result &= hashItemsEx(impl->Root, targets, impl->Algorithm, options.Threads);
+        }
+        sortItems(items);
+        impl->assign(items);
+        m_impl = std::move(impl);
+        return result;
+    }
+
+    bool DirIndex::refresh(const dir_index_options &options, std::size_t *changed)
+    {
+        if (changed)
+        {
+            *changed = 0;
+        }
+        if (!m_impl)
+        {
+            return false;
+        }
+        Impl &impl = *m_impl;
+        int root_handle = open(impl.Root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(root_handle); });
+        struct stat root_stats;
+        if (fstat(root_handle, &root_stats) != 0)
+        {
+            return false;
+        }
+
+        // Directories (and with StatFiles the rest) are checked against the
+        // filesystem on a pool, in slices of the record array
+        enum : uint8_t { same, updated, gone, replaced };
+        struct Checked
+        {
+            std::size_t Position;
+            uint8_t     State;
+            IndexRecord Fresh;
+        };
+        std::vector<Checked> checked;
+        std::mutex checked_lock;
+        {
+            constexpr std::size_t slice = 1024;
+            fs::internal::WorkStealingPool pool(fs::internal::threadCount(options.Threads));
+            for (std::size_t begin = 0; begin < impl.Count; begin += slice)
+            {
+                pool.spawn([&, begin]
+                {
+                    std::vector<Checked> local;
+                    const std::size_t end = std::min(impl.Count, begin + slice);
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        const IndexRecord &record = impl.Records[i];
+                        if (!isDirectory(record) && !options.StatFiles)
+                        {
+                            continue;
+                        }
+                        const std::string_view path = impl.path(record);
+                        struct stat stats;
+                        if (path.empty() || fstatat(root_handle, path.data(), &stats, AT_SYMLINK_NOFOLLOW) != 0)
+                        {
+                            local.push_back({ i, gone, {} });
+                            continue;
+                        }
+                        IndexRecord fresh = fromStat(stats);
+                        if (fresh.Type != record.Type)
+                        {
+                            local.push_back({ i, gone, {} });
+                        }
+                        else if (isDirectory(record) && fresh.Inode != record.Inode)
+                        {
+                            local.push_back({ i, replaced, fresh });
+                        }
+                        else if (fresh.ModifyTime != record.ModifyTime || fresh.Size != record.Size)
+                        {
+                            local.push_back({ i, updated, fresh });
+                        }
+                    }
+                    if (!local.empty())
+                    {
+                        std::lock_guard<std::mutex> guard(checked_lock);
+                        checked.insert(checked.end(), local.begin(), local.end());
+                    }
+                });
+            }
+            pool.wait();
+        }
+
+        std::vector<bool> dropped(impl.Count, false);
+        auto dropSubtree = [&](std::string_view directory)
+        {
+            std::string prefix(directory);
+            prefix += '/';
+            for (std::size_t i = impl.lowerBound(prefix); i < impl.Count && samePath(impl.path(impl.Records[i]), prefix); ++i)
+            {
+                dropped[i] = true;
+            }
+        };
+        auto dropChildren = [&](std::string_view directory)
+        {
+            std::string prefix(directory);
+            if (!prefix.empty())
+            {
+                prefix += '/';
+            }
+            for (std::size_t i = impl.lowerBound(prefix); i < impl.Count; ++i)
+            {
+                const std::string_view path = impl.path(impl.Records[i]);
+                if (!samePath(path, prefix))
+                {
+                    break;
+                }
+                if (path.find('/', prefix.size()) == path.npos)
+                {
+                    dropped[i] = true;
+                }
+            }
+        };
+
+        std::deque<std::string> names;
+        std::vector<IndexItem> fresh;
+        std::vector<std::string> relist;        // directories whose entries changed
+        std::vector<std::string> rewalk;        // directories to walk whole
+        bool result = true;
+        if (nanoseconds(root_stats.st_mtim) != impl.RootTime)
+        {
+            relist.emplace_back();
+        }
+        for (const auto &check : checked)
+        {
+            const IndexRecord &record = impl.Records[check.Position];
+            const std::string_view path = impl.path(record);
+            dropped[check.Position] = true;
+            if (isDirectory(record) && check.State != updated)
+            {
+                dropSubtree(path);
+            }
+            switch (check.State)
+            {
+            case updated:
+                names.emplace_back(path);
+                fresh.push_back({ names.back(), check.Fresh });
+                if (isDirectory(record))
+                {
+                    relist.emplace_back(path);
+                }
+                break;
+            case replaced:
+                names.emplace_back(path);
+                fresh.push_back({ names.back(), check.Fresh });
+                rewalk.emplace_back(path);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Entries of changed directories are read again, subdirectories the
+        // index didn't know (or knew as something else) are walked whole
+        for (const auto &directory : relist)
+        {
+            dropChildren(directory);
+            std::vector<IndexItem> children;
+            result &= collectEx(impl.Root, directory, 1, options.Filter, names, children);
+            for (auto &child : children)
+            {
+                if (!isDirectory(child.Record))
+                {
+                    fresh.push_back(child);
+                    continue;
+                }
+                const std::size_t known = impl.lowerBound(child.Path);
+                if (known == impl.Count || impl.path(impl.Records[known]) != child.Path ||
+                    !isDirectory(impl.Records[known]) || impl.Records[known].Inode != child.Record.Inode)
+                {
+                    rewalk.emplace_back(child.Path);
+                }
+                fresh.push_back(child);
+            }
+        }
+        std::sort(rewalk.begin(), rewalk.end());
+        for (std::size_t i = 0; i < rewalk.size(); ++i)
+        {
+            // Nested ones come with their parent
+            if (i != 0 && (rewalk[i] == rewalk[i - 1] || samePath(rewalk[i], rewalk[i - 1] + '/')))
+            {
+                rewalk.erase(rewalk.begin() + static_cast<std::ptrdiff_t>(i--));
+                continue;
+            }
+            dropSubtree(rewalk[i]);
+            result &= collectEx(impl.Root, rewalk[i], 0, options.Filter, names, fresh);
+        }
+
+        // Same path listed twice (a directory seen by its own check and by its parent's listing), keep the last
+        sortItems(fresh);
+        std::vector<IndexItem> unique;
+        unique.reserve(fresh.size());
+        for (const auto &item : fresh)
+        {
+            if (!unique.empty() && unique.back().Path == item.Path)
+            {
+                unique.back() = item;
+                continue;
+            }
+            unique.push_back(item);
+        }
+        if (impl.Hashed)
+        {
+            // Files listed again but not changed keep their hash
+            std::vector<IndexItem *> targets;
+            for (auto &item : unique)
+            {
+                const std::size_t known = impl.lowerBound(item.Path);
+                if (known != impl.Count && impl.path(impl.Records[known]) == item.Path)
+                {
+                    const IndexRecord &record = impl.Records[known];
+                    if (record.Type == item.Record.Type && record.Size == item.Record.Size &&
+                        record.ModifyTime == item.Record.ModifyTime && record.Inode == item.Record.Inode)
+                    {
+                        item.Record.Hash = record.Hash;
+                        continue;
+                    }
+                }
+                targets.push_back(&item);
+            }
+            result &= hashItemsEx(impl.Root, targets, impl.Algorithm, options.Threads);
+        }
+
+        // Kept and fresh entries are both sorted, a merge puts them together
+        std::size_t count = 0;
+        std::vector<IndexItem> merged;
+        merged.reserve(impl.Count + unique.size());
+        auto fresh_it = unique.begin();
+        for (std::size_t i = 0; i < impl.Count; ++i)
+        {
+            const IndexRecord &record = impl.Records[i];
+            const std::string_view path = impl.path(record);
+            for (; fresh_it != unique.end() && fresh_it->Path < path; ++fresh_it)
+            {
+                merged.push_back(*fresh_it);
+                ++count;
+            }
+            if (fresh_it != unique.end() && fresh_it->Path == path)
+            {
+                const IndexRecord &now = fresh_it->Record;
+                count += now.Type != record.Type || now.Size != record.Size || now.ModifyTime != record.ModifyTime || now.Hash != record.Hash;
+                merged.push_back(*fresh_it++);
+                continue;
+            }
+            if (dropped[i])
+            {
+                ++count;
+                continue;
+            }
+            merged.push_back({ path, record });
+        }
+        for (; fresh_it != unique.end(); ++fresh_it)
+        {
+            merged.push_back(*fresh_it);
+            ++count;
+        }
+        impl.assign(merged);
+        impl.RootTime = nanoseconds(root_stats.st_mtim);
+        if (changed)
+        {
+            *changed = count;
+        }
+        return result;
+    }
+
+    bool DirIndex::save(const fs::path &filePath) const
+    {
+        if (!m_impl)
+        {
+            return false;
+        }
+        const Impl &impl = *m_impl;
+        const std::string root = impl.Root.native();
+        IndexHeader header = {};
+        std::memcpy(header.Magic, index_magic, sizeof(index_magic));
+        header.Version      = index_version;
+        header.ByteOrder    = byte_order;
+        header.Hashed       = impl.Hashed;
+        header.Algorithm    = static_cast<uint8_t>(impl.Algorithm);
+        header.Count        = impl.Count;
+        header.NamesSize    = impl.NamesSize;
+        header.RootLength   = root.size();
+        header.RootTime     = impl.RootTime;
+
+        std::string data;
+        data.reserve(sizeof(header) + impl.Count * sizeof(IndexRecord) + root.size() + impl.NamesSize);
+        data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        data.append(reinterpret_cast<const char *>(impl.Records), impl.Count * sizeof(IndexRecord));
+        data.append(root);
+        data.append(impl.Names, impl.NamesSize);
+        return fs::posix::writeFileAtomic(filePath, std::string_view(data));
+    }
+
+    bool DirIndex::load(const fs::path &filePath)
+    {
+        clear();
+        auto impl = std::make_unique<Impl>();
+        impl->Mapping = fs::posix::mapFile(filePath);
+        if (!impl->Mapping || impl->Mapping.size() < sizeof(IndexHeader))
+        {
+            return false;
+        }
+        IndexHeader header;
+        std::memcpy(&header, impl->Mapping.data(), sizeof(header));
+        const uint64_t body = impl->Mapping.size() - sizeof(header);
+        if (std::memcmp(header.Magic, index_magic, sizeof(index_magic)) != 0 || header.Version != index_version ||
+            header.ByteOrder != byte_order || header.Count > body / sizeof(IndexRecord) ||
+            header.RootLength > body - header.Count * sizeof(IndexRecord) ||
+            header.NamesSize != body - header.Count * sizeof(IndexRecord) - header.RootLength)
+        {
+            errno = EINVAL;
+            return false;
+        }
+        const auto *base = reinterpret_cast<const char *>(impl->Mapping.data());
+        const char *root = base + sizeof(header) + header.Count * sizeof(IndexRecord);
+        impl->Root      = std::string(root, header.RootLength);
+        impl->RootTime  = header.RootTime;
+        impl->Hashed    = header.Hashed != 0;
+        impl->Algorithm = static_cast<fs::hash_algorithm>(header.Algorithm);
+        impl->Records   = reinterpret_cast<const IndexRecord *>(base + sizeof(header));
+        impl->Count     = header.Count;
+        impl->Names     = root + header.RootLength;
+        impl->NamesSize = header.NamesSize;
+        m_impl = std::move(impl);
+        return true;
+    }
+
+    void DirIndex::clear()
+    {
+        m_impl.reset();
+    }
+
+    bool DirIndex::empty() const
+    {
+        return size() == 0;
+    }
+
+    std::size_t DirIndex::size() const
+    {
+        return m_impl ? m_impl->Count : 0;
+    }
+
+    const fs::path &DirIndex::root() const
+    {
+        static const fs::path none;
+        return m_impl ? m_impl->Root : none;
+    }
+
+    bool DirIndex::hashed() const
+    {
+        return m_impl && m_impl->Hashed;
+    }
+
+    fs::index_entry DirIndex::entry(const std::size_t position) const
+    {
+        return m_impl && position < m_impl->Count ? m_impl->entry(position) : fs::index_entry {};
+    }
+
+    bool DirIndex::find(std::string_view path, fs::index_entry &result) const
+    {
+        if (!m_impl)
+        {
+            return false;
+        }
+        const std::size_t position = m_impl->lowerBound(path);
+        if (position == m_impl->Count || m_impl->path(m_impl->Records[position]) != path)
+        {
+            return false;
+        }
+        result = m_impl->entry(position);
+        return true;
+    }
+
+    std::vector<fs::index_entry> DirIndex::list(std::string_view directory) const
+    {
+        return match(fs::NameFilter(), directory, false);
+    }
+
+    std::vector<fs::index_entry> DirIndex::prefix(std::string_view prefix) const
+    {
+        std::vector<fs::index_entry> result;
+        if (!m_impl)
+        {
+            return result;
+        }
+        for (std::size_t i = m_impl->lowerBound(prefix); i < m_impl->Count && samePath(m_impl->path(m_impl->Records[i]), prefix); ++i)
+        {
+            result.push_back(m_impl->entry(i));
+        }
+        return result;
+    }
+
+    std::vector<fs::index_entry> DirIndex::match(const fs::NameFilter &filter, std::string_view directory, const bool recursive) const
+    {
+        std::vector<fs::index_entry> result;
+        if (!m_impl)
+        {
+            return result;
+        }
+        std::string prefix(directory);
+        if (!prefix.empty() && prefix.back() != '/')
+        {
+            prefix += '/';
+        }
+        std::size_t i = m_impl->lowerBound(prefix);
+        while (i < m_impl->Count)
+        {
+            const auto entry = m_impl->entry(i);
+            if (!samePath(entry.Path, prefix))
+            {
+                break;
+            }
+            const std::size_t slash = entry.Path.find('/', prefix.size());
+            if (!recursive && slash != entry.Path.npos)
+            {
+                // Inside a child directory: skip its whole subtree, '0' follows '/'
+                std::string next(entry.Path.substr(0, slash));
+                next += '0';
+                i = m_impl->lowerBound(next, i);
+                continue;
+            }
+            if (filter.matchesAll() || filter.match(entry.name()))
+            {
+                result.push_back(entry);
+            }
+            ++i;
+        }
+        return result;
+    }
+}
+#endif
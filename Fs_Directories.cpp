@@ -0,0 +1,179 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <map>
+
+namespace
+{
+    constexpr std::size_t leaves_per_task = 64;
+
+    // One path component of the requested trees, shared prefixes are created once
+    struct MkdirNode
+    {
+        std::string                         Name;
+        std::string                         Path;       // as spelled by the caller, key for Known
+        bool                                Trusted = false;
+        std::map<std::string, MkdirNode>    Children;
+    };
+
+    // Directory fd shared by the tasks creating its children
+    struct SharedHandle
+    {
+        explicit SharedHandle(const int handle) : Handle(handle) {}
+        ~SharedHandle() { fs::internal::closeHandle(Handle); }
+
+        int Handle;
+    };
+
+    struct MkdirTree
+    {
+        MkdirTree(const fs::mkdir_options &options)
+            : Options(options),
+              Pool(fs::internal::threadCount(options.Threads))
+        {
+        }
+
+        // name is relative to parent, possibly several trusted components long
+        bool make(const int parent, const std::string &name, const MkdirNode &node)
+        {
+            if (node.Trusted)
+            {
+                return true;
+            }
+            if (mkdirat(parent, name.c_str(), Options.Mode) != 0)
+            {
+                struct stat stats;
+                if (errno != EEXIST || fstatat(parent, name.c_str(), &stats, 0) != 0 || !S_ISDIR(stats.st_mode))
+                {
+                    Failed = true;
+                    return false;
+                }
+            }
+            if (Options.Known)
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                Created.push_back(node.Path);
+            }
+            return true;
+        }
+
+        void process(const std::shared_ptr<SharedHandle> &parent, const std::string &prefix, const MkdirNode &node)
+        {
+            const std::string name = prefix + node.Name;
+            if (!make(parent->Handle, name, node) || node.Children.empty())
+            {
+                return;
+            }
+            if (node.Trusted)
+            {
+                // Nothing to create here, children go relative to the same fd
+                descend(parent, name + "/", node);
+                return;
+            }
+            const int handle = openat(parent->Handle, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (handle < 0)
+            {
+                Failed = true;
+                return;
+            }
+            descend(std::make_shared<SharedHandle>(handle), {}, node);
+        }
+
+        // Inner nodes get a task each, leaves are created in batches
+        void descend(const std::shared_ptr<SharedHandle> &parent, const std::string &prefix, const MkdirNode &node)
+        {
+            auto leaves = std::make_shared<std::vector<const MkdirNode *>>();
+            for (const auto &it : node.Children)
+            {
+                const MkdirNode &child = it.second;
+                if (child.Children.empty())
+                {
+                    leaves->push_back(&child);
+                    continue;
+                }
+                Pool.spawn([this, parent, prefix, &child] { process(parent, prefix, child); });
+            }
+            for (std::size_t first = 0; first < leaves->size(); first += leaves_per_task)
+            {
+                const std::size_t last = std::min(first + leaves_per_task, leaves->size());
+                auto run = [this, parent, prefix, leaves, first, last]
+                {
+                    for (std::size_t i = first; i < last; ++i)
+                    {
+                        make(parent->Handle, prefix + (*leaves)[i]->Name, *(*leaves)[i]);
+                    }
+                };
+                // The last batch runs here, the rest is spawned
+                if (last == leaves->size())
+                {
+                    run();
+                }
+                else
+                {
+                    Pool.spawn(run);
+                }
+            }
+        }
+
+        const fs::mkdir_options        &Options;
+        fs::internal::WorkStealingPool  Pool;
+        std::atomic<bool>               Failed  { false };
+        std::mutex                      Lock;
+        std::vector<std::string>        Created;
+    };
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool createDirectories(const std::vector<fs::path> &paths, const fs::mkdir_options &options)
+    {
+        // Roots are "/" and "." (relative input)
+        std::map<std::string, MkdirNode> roots;
+        for (const auto &it : paths)
+        {
+            const auto normal = it.lexically_normal();
+            MkdirNode *node = &roots[normal.is_absolute() ? "/" : "."];
+            std::string spelled = normal.is_absolute() ? "/" : "";
+            for (const auto &part : normal.relative_path())
+            {
+                if (part.empty() || part == ".")
+                {
+                    continue;
+                }
+                spelled += spelled.empty() || spelled.back() == '/' ? part.native() : "/" + part.native();
+                auto &child = node->Children[part.native()];
+                if (child.Name.empty())
+                {
+                    child.Name    = part.native();
+                    child.Path    = spelled;
+                    child.Trusted = options.Known && options.Known->count(spelled) != 0;
+                }
+                node = &child;
+            }
+        }
+
+        MkdirTree tree(options);
+        for (const auto &root : roots)
+        {
+            const int handle = open(root.first.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (handle < 0)
+            {
+                tree.Failed = true;
+                continue;
+            }
+            auto shared = std::make_shared<SharedHandle>(handle);
+            tree.Pool.spawn([&tree, shared, &root] { tree.descend(shared, {}, root.second); });
+        }
+        tree.Pool.wait();
+        if (options.Known)
+        {
+            options.Known->insert(tree.Created.begin(), tree.Created.end());
+        }
+        return !tree.Failed;
+    }
+}
+#endif
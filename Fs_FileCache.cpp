@@ -0,0 +1,460 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include <list>
+#include <unordered_map>
+
+namespace
+{
+    constexpr uint32_t watch_events = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    struct FileIdentity
+    {
+        uint64_t    Device  = 0;
+        uint64_t    Inode   = 0;
+        uint64_t    Size    = 0;
+        int64_t     Modify  = 0;
+        int64_t     Change  = 0;
+
+        explicit FileIdentity(const struct stat &stats)
+            : Device(stats.st_dev),
+              Inode(stats.st_ino),
+              Size(static_cast<uint64_t>(stats.st_size)),
+              Modify(stats.st_mtim.tv_sec * 1000000000LL + stats.st_mtim.tv_nsec),
+              Change(stats.st_ctim.tv_sec * 1000000000LL + stats.st_ctim.tv_nsec)
+        {
+        }
+
+        bool operator==(const FileIdentity &other) const
+        {
+            return Device == other.Device && Inode == other.Inode && Size == other.Size &&
+                   Modify == other.Modify && Change == other.Change;
+        }
+    };
+
+    bool readIdentified(const std::string &filePath, fs::ReadBuffer &data, struct stat &stats)
+    {
+        int file_handle = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        if (fstat(file_handle, &stats) != 0 || S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        return fs::internal::readHandle(file_handle, stats, data);
+    }
+}
+
+namespace fs
+{
+    struct FileCache::Impl
+    {
+        struct Entry
+        {
+            FileCache::buffer                   Data;
+            FileIdentity                        Identity;
+            int                                 Watch;
+            std::list<std::string>::iterator    Order;
+        };
+
+        struct WatchedDir
+        {
+            std::vector<std::string>    Paths;      // every spelling that led to this watch
+            std::size_t                 Entries     = 0;
+            uint64_t                    Generation  = 0;    // restamped on every event, a read racing one isn't cached
+        };
+
+        explicit Impl(const file_cache_options &options);
+        ~Impl();
+
+        std::string key(const fs::path &filePath) const;
+        FileCache::buffer read(const fs::path &filePath);
+        // Under Lock
+        void erase(std::unordered_map<std::string, Entry>::iterator it);
+        void evict();
+        int  watch(const std::string &directory);
+        void unwatchIdle(const int watch_handle);
+        void dropDirectory(const int watch);
+        void forget(std::unordered_map<int, WatchedDir>::iterator dir);
+        void handleEvents();
+
+        file_cache_options                      Options;
+        mutable std::mutex                      Lock;
+        std::unordered_map<std::string, Entry>  Entries;
+        std::list<std::string>                  Order;      // most recently used first
+        std::unordered_map<int, WatchedDir>     Watches;
+        std::unordered_map<std::string, int>    WatchByPath;
+        file_cache_stats                        Stats;
+        std::atomic<cache_validation>           Validation  { cache_validation::stat };   // falls back to stat if the watcher thread dies
+        int                                     Inotify     = -1;
+        int                                     StopEvent   = -1;
+        uint64_t                                Stamp       = 0;        // source of Generation values, never reused
+        std::thread                             Watcher;
+    };
+
+    FileCache::Impl::Impl(const file_cache_options &options)
+        : Options(options)
+    {
+        if (Options.Validation != cache_validation::inotify)
+        {
+            return;
+        }
+        Inotify   = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        StopEvent = eventfd(0, EFD_CLOEXEC);
+        if (Inotify < 0 || StopEvent < 0)
+        {
+            fs::internal::closeHandle(Inotify);
+            fs::internal::closeHandle(StopEvent);
+            Options.Validation = cache_validation::stat;
+            return;
+        }
+        Validation = cache_validation::inotify;
+        Watcher = std::thread([this] { handleEvents(); });
+    }
+
+    FileCache::Impl::~Impl()
+    {
+        if (Watcher.joinable())
+        {
+            const uint64_t one = 1;
+            [[maybe_unused]] const auto res = write(StopEvent, &one, sizeof(one));
+            Watcher.join();
+        }
+        fs::internal::closeHandle(Inotify);
+        fs::internal::closeHandle(StopEvent);
+    }
+
+    std::string FileCache::Impl::key(const fs::path &filePath) const
+    {
+        // Lexical only (one getcwd at most), and spelled the way directory + '/' + event name is
+        std::error_code err;
+        const auto &working_path = filePath.is_absolute() ? filePath : std::filesystem::absolute(filePath, err);
+        return working_path.lexically_normal().native();
+    }
+
+    void FileCache::Impl::erase(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        Stats.Bytes -= it->second.Data->size();
+        const int watch_handle = it->second.Watch;
+        Order.erase(it->second.Order);
+        Entries.erase(it);
+        const auto dir = Watches.find(watch_handle);
+        if (dir != Watches.end())
+        {
+            --dir->second.Entries;
+            unwatchIdle(watch_handle);
+        }
+    }
+
+    // Drops a watch no entry relies on, read() adds one before knowing the file gets cached
+    void FileCache::Impl::unwatchIdle(const int watch_handle)
+    {
+        const auto dir = Watches.find(watch_handle);
+        if (dir != Watches.end() && dir->second.Entries == 0)
+        {
+            // Nothing left to watch for, IN_IGNORED for it is ignored as unknown
+            inotify_rm_watch(Inotify, watch_handle);
+            forget(dir);
+        }
+    }
+
+    void FileCache::Impl::evict()
+    {
+        while (Stats.Bytes > Options.MaxBytes && !Order.empty())
+        {
+            erase(Entries.find(Order.back()));
+            ++Stats.Evictions;
+        }
+    }
+
+    int FileCache::Impl::watch(const std::string &directory)
+    {
+        const auto known = WatchByPath.find(directory);
+        if (known != WatchByPath.end())
+        {
+            return known->second;
+        }
+        const int watch_handle = inotify_add_watch(Inotify, directory.c_str(), watch_events | IN_ONLYDIR);
+        if (watch_handle < 0)
+        {
+            return -1;
+        }
+        // Same directory under another spelling gets the same descriptor
+        auto &dir = Watches[watch_handle];
+        if (dir.Paths.empty())
+        {
+            dir.Generation = ++Stamp;
+        }
+        dir.Paths.push_back(directory);
+        WatchByPath[directory] = watch_handle;
+        return watch_handle;
+    }
+
+    void FileCache::Impl::forget(std::unordered_map<int, WatchedDir>::iterator dir)
+    {
+        for (const auto &path : dir->second.Paths)
+        {
+            WatchByPath.erase(path);
+        }
+        Watches.erase(dir);
+    }
+
+    void FileCache::Impl::dropDirectory(const int watch)
+    {
+        for (auto it = Entries.begin(); it != Entries.end();)
+        {
+            if (it->second.Watch == watch)
+            {
+                const auto next = std::next(it);
+                ++Stats.Invalidations;
+                erase(it);
+                it = next;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void FileCache::Impl::handleEvents()
+    {
+        alignas(inotify_event) char buffer[16 * 1024];
+        pollfd handles[2] = { { Inotify, POLLIN, 0 }, { StopEvent, POLLIN, 0 } };
+        while (true)
+        {
+            if (poll(handles, 2, -1) < 0 && errno != EINTR)
+            {
+                if (errno == ENOMEM || errno == EAGAIN)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                // No more events: entries carry their identity, stat validation takes over
+                std::lock_guard<std::mutex> guard(Lock);
+                Validation = cache_validation::stat;
+                for (const auto &it : Watches)
+                {
+                    inotify_rm_watch(Inotify, it.first);
+                }
+                Watches.clear();
+                WatchByPath.clear();
+                break;
+            }
+            if (handles[1].revents)
+            {
+                break;
+            }
+            const ssize_t length = ::read(Inotify, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(Lock);
+            for (ssize_t pos = 0; pos < length;)
+            {
+                const auto *event = reinterpret_cast<const inotify_event *>(buffer + pos);
+                pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    // Events were lost, nothing cached can be trusted
+                    for (auto &it : Watches)
+                    {
+                        it.second.Generation = ++Stamp;
+                    }
+                    while (!Entries.empty())
+                    {
+                        ++Stats.Invalidations;
+                        erase(Entries.begin());
+                    }
+                    continue;
+                }
+                const auto dir = Watches.find(event->wd);
+                if (dir == Watches.end())
+                {
+                    continue;
+                }
+                dir->second.Generation = ++Stamp;
+                if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+                {
+                    // The path no longer names this directory. Reads in flight
+                    // don't find their watch any more and aren't cached.
+                    const int watch_handle = event->wd;
+                    dropDirectory(watch_handle);
+                    const auto gone = Watches.find(watch_handle);
+                    if (gone != Watches.end())
+                    {
+                        if (!(event->mask & IN_IGNORED))
+                        {
+                            inotify_rm_watch(Inotify, watch_handle);
+                        }
+                        forget(gone);
+                    }
+                    continue;
+                }
+                // Copy, erasing the last entry drops the watch
+                const auto paths = event->len ? dir->second.Paths : std::vector<std::string>();
+                for (const auto &path : paths)
+                {
+                    const auto it = Entries.find(path + "/" + event->name);
+                    if (it != Entries.end())
+                    {
+                        ++Stats.Invalidations;
+                        erase(it);
+                    }
+                }
+            }
+        }
+    }
+
+    FileCache::FileCache(const file_cache_options &options)
+        : m_impl(std::make_unique<Impl>(options))
+    {
+    }
+
+    FileCache::~FileCache() = default;
+
+    FileCache::buffer FileCache::read(const fs::path &filePath)
+    {
+        FS_TRACED(read, &filePath, m_impl->read(filePath), result_ ? result_->size() : 0, static_cast<bool>(result_))
+    }
+
+    FileCache::buffer FileCache::Impl::read(const fs::path &filePath)
+    {
+        Impl &impl = *this;
+        const bool by_inotify = impl.Validation == cache_validation::inotify;
+        const auto cache_key  = impl.key(filePath);
+        const auto directory  = fs::path(cache_key).parent_path().native();
+        struct stat stats;
+        // Identity check happens outside the lock, it is the only syscall of a stat validated hit
+        const bool have_stats = !by_inotify && ::stat(cache_key.c_str(), &stats) == 0;
+        int         watch_handle = -1;
+        uint64_t    generation   = 0;
+        {
+            std::lock_guard<std::mutex> guard(impl.Lock);
+            const auto it = impl.Entries.find(cache_key);
+            if (it != impl.Entries.end())
+            {
+                // Rechecked under the lock, a stale inotify read can't hit once stat took over
+                if ((by_inotify && impl.Validation == cache_validation::inotify) ||
+                    (have_stats && it->second.Identity == FileIdentity(stats)))
+                {
+                    impl.Order.splice(impl.Order.begin(), impl.Order, it->second.Order);
+                    ++impl.Stats.Hits;
+                    return it->second.Data;
+                }
+                ++impl.Stats.Invalidations;
+                impl.erase(it);
+            }
+            ++impl.Stats.Misses;
+            if (by_inotify)
+            {
+                // Watch before reading, a change during the read then bumps the generation
+                watch_handle = impl.watch(directory);
+                if (watch_handle >= 0)
+                {
+                    generation = impl.Watches[watch_handle].Generation;
+                }
+            }
+        }
+
+        // Every way out that doesn't cache the file gives the watch back, after guard below is released
+        bool cached = false;
+        MakeScopeGuard([&]
+        {
+            if (watch_handle >= 0 && !cached)
+            {
+                std::lock_guard<std::mutex> guard(impl.Lock);
+                impl.unwatchIdle(watch_handle);
+            }
+        });
+        auto data = std::make_shared<fs::ReadBuffer>();
+        if (!readIdentified(cache_key, *data, stats))
+        {
+            return nullptr;
+        }
+        FileCache::buffer result = std::move(data);
+        if (result->size() > impl.Options.MaxFileSize || (by_inotify && watch_handle < 0))
+        {
+            return result;
+        }
+
+        std::lock_guard<std::mutex> guard(impl.Lock);
+        if (by_inotify)
+        {
+            const auto dir = impl.Watches.find(watch_handle);
+            if (dir == impl.Watches.end() || dir->second.Generation != generation)
+            {
+                return result;
+            }
+        }
+        if (impl.Entries.count(cache_key))
+        {
+            // Another reader got here first, keep its buffer
+            return result;
+        }
+        cached = true;
+        impl.Order.push_front(cache_key);
+        impl.Entries.emplace(cache_key, Impl::Entry{ result, FileIdentity(stats), watch_handle, impl.Order.begin() });
+        if (by_inotify)
+        {
+            ++impl.Watches[watch_handle].Entries;
+        }
+        impl.Stats.Bytes += result->size();
+        impl.evict();
+        return result;
+    }
+
+    void FileCache::invalidate(const fs::path &filePath)
+    {
+        const auto cache_key = m_impl->key(filePath);
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        const auto it = m_impl->Entries.find(cache_key);
+        if (it != m_impl->Entries.end())
+        {
+            m_impl->erase(it);
+        }
+    }
+
+    void FileCache::clear()
+    {
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        while (!m_impl->Entries.empty())
+        {
+            m_impl->erase(m_impl->Entries.begin());
+        }
+    }
+
+    cache_validation FileCache::validation() const
+    {
+        return m_impl->Validation;
+    }
+
+    file_cache_stats FileCache::stats() const
+    {
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        auto result    = m_impl->Stats;
+        result.Entries = m_impl->Entries.size();
+        return result;
+    }
+
+    void FileCache::resetStats()
+    {
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        const auto bytes = m_impl->Stats.Bytes;
+        m_impl->Stats       = {};
+        m_impl->Stats.Bytes = bytes;
+    }
+}
+#endif
@@ -0,0 +1,198 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+namespace
+{
+    int fileAdvice(const fs::map_advice advice)
+    {
+        switch (advice)
+        {
+        case fs::map_advice::sequential:    return POSIX_FADV_SEQUENTIAL;
+        case fs::map_advice::random:        return POSIX_FADV_RANDOM;
+        case fs::map_advice::willneed:      return POSIX_FADV_WILLNEED;
+        case fs::map_advice::dontneed:      return POSIX_FADV_DONTNEED;
+        case fs::map_advice::normal:        return POSIX_FADV_NORMAL;
+        default:                            return -1;
+        }
+    }
+
+    bool readHandleAt(const int fileHandle, const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes)
+    {
+        readBytes = 0;
+        return fileHandle >= 0 && fs::internal::preadFull(fileHandle, data, length, offset, readBytes);
+    }
+
+    bool readHandleAt(const int fileHandle, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data)
+    {
+        std::size_t read_bytes = 0;
+        data.resizeForOverwrite(length);
+        if (!readHandleAt(fileHandle, offset, data.data(), length, read_bytes))
+        {
+            data.clear();
+            return false;
+        }
+        data.resizeForOverwrite(read_bytes);
+        return true;
+    }
+
+    bool syncHandle(const int fileHandle, const bool dataOnly)
+    {
+        return fileHandle >= 0 && (dataOnly ? fdatasync(fileHandle) : fsync(fileHandle)) == 0;
+    }
+
+    bool readRangeEx(const fs::path &filePath, const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes, const bool silent)
+    {
+        readBytes = 0;
+        fs::internal::SilentAccess access;
+        int file_handle = access.open(filePath.c_str(), O_RDONLY | O_CLOEXEC, silent);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        return fs::internal::preadFull(file_handle, data, length, offset, readBytes);
+    }
+
+    bool readRangeEx(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data, const bool silent)
+    {
+        std::size_t read_bytes = 0;
+        data.resizeForOverwrite(length);
+        if (!readRangeEx(filePath, offset, data.data(), length, read_bytes, silent))
+        {
+            data.clear();
+            return false;
+        }
+        data.resizeForOverwrite(read_bytes);
+        return true;
+    }
+
+    // Creates the file when missing, a write past the end leaves a hole
+    bool writeAtEx(const fs::path &filePath, const uint64_t offset, const void *data, const std::size_t length)
+    {
+        int file_handle = open(filePath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        return fs::internal::pwriteFull(file_handle, data, length, offset);
+    }
+}
+
+namespace fs
+{
+    FileHandle::FileHandle(FileHandle &&other) noexcept
+        : m_handle(other.m_handle)
+    {
+        other.m_handle = -1;
+    }
+
+    FileHandle &FileHandle::operator=(FileHandle &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            std::swap(m_handle, other.m_handle);
+        }
+        return *this;
+    }
+
+    FileHandle::~FileHandle()
+    {
+        close();
+    }
+
+    bool FileHandle::open(const fs::path &filePath, const bool writable)
+    {
+        close();
+        m_handle = ::open(filePath.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0666);
+        return m_handle >= 0;
+    }
+
+    void FileHandle::close()
+    {
+        fs::internal::closeHandle(m_handle);
+    }
+
+    uint64_t FileHandle::size() const
+    {
+        struct stat stats;
+        return m_handle >= 0 && fstat(m_handle, &stats) == 0 ? static_cast<uint64_t>(stats.st_size) : 0;
+    }
+
+    bool FileHandle::readAt(const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes) const
+    {
+        FS_TRACED(read, nullptr, readHandleAt(m_handle, offset, data, length, readBytes), result_ ? readBytes : 0, result_)
+    }
+
+    bool FileHandle::readAt(const uint64_t offset, const std::size_t length, fs::ReadBuffer &data) const
+    {
+        FS_TRACED(read, nullptr, readHandleAt(m_handle, offset, length, data), result_ ? data.size() : 0, result_)
+    }
+
+    bool FileHandle::writeAt(const uint64_t offset, const void *data, const std::size_t length) const
+    {
+        FS_TRACED(write, nullptr, m_handle >= 0 && fs::internal::pwriteFull(m_handle, data, length, offset), result_ ? length : 0, result_)
+    }
+
+    bool FileHandle::advise(const map_advice advice, const uint64_t offset, const uint64_t length) const
+    {
+        const int file_advice = fileAdvice(advice);
+        if (m_handle < 0 || file_advice < 0)
+        {
+            return false;
+        }
+        return posix_fadvise(m_handle, static_cast<off_t>(offset), static_cast<off_t>(length), file_advice) == 0;
+    }
+
+    bool FileHandle::sync(const bool dataOnly) const
+    {
+        FS_TRACED(sync, nullptr, syncHandle(m_handle, dataOnly), 0, result_)
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool readRange(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data, const bool silent)
+    {
+        return readRangeEx(filePath, offset, length, data, silent);
+    }
+
+    LIB_EXPORT
+    bool readRange(const fs::path &filePath, const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes, const bool silent)
+    {
+        return readRangeEx(filePath, offset, data, length, readBytes, silent);
+    }
+
+    LIB_EXPORT
+    bool writeAt(const fs::path &filePath, const uint64_t offset, std::string_view data)
+    {
+        return writeAtEx(filePath, offset, data.data(), data.size());
+    }
+
+    LIB_EXPORT
+    bool writeAt(const fs::path &filePath, const uint64_t offset, const std::vector<uint8_t> &data)
+    {
+        return writeAtEx(filePath, offset, data.data(), data.size());
+    }
+
+#if defined IS_CPP_20G
+    LIB_EXPORT
+    bool readRange(const fs::path &filePath, const uint64_t offset, std::span<std::byte> data, std::size_t &readBytes, const bool silent)
+    {
+        return readRangeEx(filePath, offset, data.data(), data.size(), readBytes, silent);
+    }
+
+    LIB_EXPORT
+    bool writeAt(const fs::path &filePath, const uint64_t offset, std::span<const std::byte> data)
+    {
+        return writeAtEx(filePath, offset, data.data(), data.size());
+    }
+#endif
+}
+#endif
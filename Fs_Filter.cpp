@@ -0,0 +1,304 @@
+#include "FsLib.h"
+
+#include <bitset>
+
+namespace
+{
+    struct Token
+    {
+        enum class type : uint8_t
+        {
+            literal,
+            one,        // ?
+            star,       // *
+            set,        // [...]
+        };
+        type                Type    = type::literal;
+        std::string         Text;
+        std::bitset<256>    Set;
+    };
+}
+
+namespace fs
+{
+    struct NameFilter::Compiled
+    {
+        std::vector<Token>  Tokens;
+        std::regex          Regex;
+    };
+}
+
+namespace
+{
+    bool isGlobMeta(const char c)
+    {
+        return c == '*' || c == '?' || c == '[';
+    }
+
+    // [abc] [a-z] [!abc] [^abc], returns false on an unterminated class so the caller takes '[' literally
+    bool parseSet(std::string_view pattern, std::size_t &pos, std::bitset<256> &set)
+    {
+        std::size_t it = pos + 1;
+        bool negate = false;
+        if (it < pattern.size() && (pattern[it] == '!' || pattern[it] == '^'))
+        {
+            negate = true;
+            ++it;
+        }
+        const std::size_t first = it;
+        for (; it < pattern.size() && (pattern[it] != ']' || it == first); ++it)
+        {
+            const auto low = static_cast<unsigned char>(pattern[it]);
+            if (it + 2 < pattern.size() && pattern[it + 1] == '-' && pattern[it + 2] != ']')
+            {
+                const auto high = static_cast<unsigned char>(pattern[it + 2]);
+                for (unsigned c = low; c <= high; ++c)
+                {
+                    set.set(c);
+                }
+                it += 2;
+            }
+            else
+            {
+                set.set(low);
+            }
+        }
+        if (it >= pattern.size())
+        {
+            set.reset();
+            return false;
+        }
+        if (negate)
+        {
+            set.flip();
+        }
+        pos = it + 1;
+        return true;
+    }
+
+    std::vector<Token> compileGlob(std::string_view pattern)
+    {
+        std::vector<Token> tokens;
+        auto literal = [&](const char c)
+        {
+            if (tokens.empty() || tokens.back().Type != Token::type::literal)
+            {
+                tokens.emplace_back();
+            }
+            tokens.back().Text += c;
+        };
+        for (std::size_t pos = 0; pos < pattern.size();)
+        {
+            const char c = pattern[pos];
+            if (c == '*')
+            {
+                // ** is the same as *
+                if (tokens.empty() || tokens.back().Type != Token::type::star)
+                {
+                    tokens.emplace_back();
+                    tokens.back().Type = Token::type::star;
+                }
+                ++pos;
+            }
+            else if (c == '?')
+            {
+                tokens.emplace_back();
+                tokens.back().Type = Token::type::one;
+                ++pos;
+            }
+            else if (c == '[')
+            {
+                Token token;
+                token.Type = Token::type::set;
+                if (parseSet(pattern, pos, token.Set))
+                {
+                    tokens.push_back(std::move(token));
+                }
+                else
+                {
+                    literal(c);
+                    ++pos;
+                }
+            }
+            else
+            {
+                literal(c);
+                ++pos;
+            }
+        }
+        return tokens;
+    }
+
+    // Greedy match, backtracking only to the last star
+    bool matchGlob(const std::vector<Token> &tokens, std::string_view name)
+    {
+        std::size_t token      = 0,
+                    pos        = 0,
+                    star_token = std::string_view::npos,
+                    star_pos   = 0;
+        while (pos < name.size() || token < tokens.size())
+        {
+            if (token < tokens.size())
+            {
+                const auto &it = tokens[token];
+                switch (it.Type)
+                {
+                case Token::type::star:
+                    star_token = token++;
+                    star_pos   = pos;
+                    continue;
+                case Token::type::literal:
+                    if (name.compare(pos, it.Text.size(), it.Text) == 0)
+                    {
+                        pos += it.Text.size();
+                        ++token;
+                        continue;
+                    }
+                    break;
+                case Token::type::one:
+                    if (pos < name.size())
+                    {
+                        ++pos;
+                        ++token;
+                        continue;
+                    }
+                    break;
+                case Token::type::set:
+                    if (pos < name.size() && it.Set.test(static_cast<unsigned char>(name[pos])))
+                    {
+                        ++pos;
+                        ++token;
+                        continue;
+                    }
+                    break;
+                }
+            }
+            if (star_token != std::string_view::npos && star_pos < name.size())
+            {
+                token = star_token + 1;
+                pos   = ++star_pos;
+                continue;
+            }
+            return false;
+        }
+        return true;
+    }
+}
+
+namespace fs
+{
+    NameFilter NameFilter::glob(std::string_view pattern)
+    {
+        NameFilter result;
+        if (pattern.empty() || pattern == "*")
+        {
+            return result;
+        }
+        const std::size_t meta_count = std::count_if(pattern.begin(), pattern.end(), isGlobMeta);
+        const std::size_t star_count = std::count(pattern.begin(), pattern.end(), '*');
+        // Shapes that don't need the glob engine at all
+        if (meta_count == 0)
+        {
+            return exact(pattern);
+        }
+        if (meta_count == star_count && star_count <= 2)
+        {
+            const bool lead  = pattern.front() == '*',
+                       trail = pattern.back() == '*';
+            const auto inner = pattern.substr(lead ? 1 : 0, pattern.size() - (lead ? 1 : 0) - (trail ? 1 : 0));
+            if (inner.find('*') == std::string_view::npos)
+            {
+                if (lead && trail)
+                {
+                    result.m_kind = kind::contains;
+                    result.m_text = std::string(inner);
+                    return result;
+                }
+                if (star_count == 1)
+                {
+                    return lead ? suffix(inner) : prefix(inner);
+                }
+            }
+        }
+        auto compiled = std::make_shared<Compiled>();
+        compiled->Tokens   = compileGlob(pattern);
+        result.m_kind      = kind::glob;
+        result.m_compiled  = std::move(compiled);
+        return result;
+    }
+
+    NameFilter NameFilter::regex(const std::string &pattern)
+    {
+        NameFilter result;
+        if (pattern.empty())
+        {
+            return result;
+        }
+        static const char regex_meta[] = ".[]{}()\\*+?^$|";
+        if (pattern.find_first_of(regex_meta) == std::string::npos)
+        {
+            return exact(pattern);
+        }
+        auto compiled = std::make_shared<Compiled>();
+        try
+        {
+            compiled->Regex = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+        }
+        catch (const std::regex_error &)
+        {
+            result.m_kind = kind::none;
+            return result;
+        }
+        result.m_kind     = kind::regex;
+        result.m_compiled = std::move(compiled);
+        return result;
+    }
+
+    NameFilter NameFilter::exact(std::string_view name)
+    {
+        NameFilter result;
+        result.m_kind = kind::exact;
+        result.m_text = std::string(name);
+        return result;
+    }
+
+    NameFilter NameFilter::prefix(std::string_view prefix)
+    {
+        NameFilter result;
+        result.m_kind = kind::prefix;
+        result.m_text = std::string(prefix);
+        return result;
+    }
+
+    NameFilter NameFilter::suffix(std::string_view suffix)
+    {
+        NameFilter result;
+        result.m_kind = kind::suffix;
+        result.m_text = std::string(suffix);
+        return result;
+    }
+
+    bool NameFilter::match(std::string_view name) const
+    {
+        switch (m_kind)
+        {
+        case kind::any:
+            return true;
+        case kind::none:
+            return false;
+        case kind::exact:
+            return name == m_text;
+        case kind::prefix:
+            return name.size() >= m_text.size() && name.compare(0, m_text.size(), m_text) == 0;
+        case kind::suffix:
+            return name.size() >= m_text.size() && name.compare(name.size() - m_text.size(), m_text.size(), m_text) == 0;
+        case kind::contains:
+            return name.find(m_text) != std::string_view::npos;
+        case kind::glob:
+            return matchGlob(m_compiled->Tokens, name);
+        case kind::regex:
+            return std::regex_match(name.begin(), name.end(), m_compiled->Regex);
+        }
+        return false;
+    }
+}
@@ -0,0 +1,417 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+
+#include <cstring>
+
+#if defined __x86_64__
+#include <nmmintrin.h>
+#elif defined __aarch64__ && defined __ARM_FEATURE_CRC32
+#include <arm_acle.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t crc_poly = 0x82f63b78u;      // Castagnoli, bit reversed
+
+    // Table[k][n]: crc of byte n followed by k zero bytes, for slicing by 8
+    struct CrcTables
+    {
+        uint32_t Table[8][256] = {};
+    };
+
+    constexpr CrcTables makeCrcTables()
+    {
+        CrcTables tables;
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t crc = n;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = crc & 1 ? (crc >> 1) ^ crc_poly : crc >> 1;
+            }
+            tables.Table[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            for (std::size_t k = 1; k < 8; ++k)
+            {
+                const uint32_t prev = tables.Table[k - 1][n];
+                tables.Table[k][n] = (prev >> 8) ^ tables.Table[0][prev & 0xff];
+            }
+        }
+        return tables;
+    }
+
+    constexpr CrcTables crc_tables = makeCrcTables();
+
+    // a(x) * b(x) modulo the polynomial, bit reversed like the crc itself
+    constexpr uint32_t multModPoly(uint32_t a, uint32_t b)
+    {
+        uint32_t product = 0;
+        for (uint32_t mask = 1u << 31; mask != 0; mask >>= 1)
+        {
+            if (a & mask)
+            {
+                product ^= b;
+                if ((a & (mask - 1)) == 0)
+                {
+                    break;
+                }
+            }
+            b = b & 1 ? (b >> 1) ^ crc_poly : b >> 1;
+        }
+        return product;
+    }
+
+    // x^(8 * bytes) modulo the polynomial: multiplying a crc register by it
+    // appends that many zero bytes
+    constexpr uint32_t zerosOperator(uint64_t bytes)
+    {
+        uint32_t power  = 1u << 30;     // x^1
+        uint32_t result = 1u << 31;     // x^0
+        // Square and multiply over the bits of 8 * bytes
+        for (int bit = 0; bit < 3; ++bit)
+        {
+            power = multModPoly(power, power);
+        }
+        for (; bytes != 0; bytes >>= 1)
+        {
+            if (bytes & 1)
+            {
+                result = multModPoly(power, result);
+            }
+            power = multModPoly(power, power);
+        }
+        return result;
+    }
+
+    uint64_t load64(const uint8_t *src)
+    {
+        uint64_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+
+    uint32_t load32(const uint8_t *src)
+    {
+        uint32_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+
+    // Raw crc register in and out, the inversions are the caller's
+    uint32_t crcSoftware(uint32_t crc, const uint8_t *src, std::size_t size)
+    {
+        const auto &t = crc_tables.Table;
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (; size >= 8; src += 8, size -= 8)
+        {
+            const uint64_t word = load64(src) ^ crc;
+            crc = t[7][word & 0xff]         ^ t[6][(word >> 8) & 0xff]  ^ t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+                  t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^ t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+        }
+#endif
+        for (; size != 0; ++src, --size)
+        {
+            crc = t[0][(crc ^ *src) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#if defined __x86_64__ || (defined __aarch64__ && defined __ARM_FEATURE_CRC32)
+    // The crc instruction has a latency of 3 and a throughput of 1: three
+    // independent lanes keep it busy, lane results are joined by shifting
+    constexpr std::size_t   crc_lane        = 4096;
+    constexpr uint32_t      crc_lane_shift  = zerosOperator(crc_lane);
+
+#if defined __x86_64__
+#define FS_CRC_TARGET       __attribute__((target("sse4.2")))
+#define FS_CRC_64(c_, v_)   _mm_crc32_u64(c_, v_)
+#define FS_CRC_8(c_, v_)    _mm_crc32_u8(c_, v_)
+#else
+#define FS_CRC_TARGET
+#define FS_CRC_64(c_, v_)   __crc32cd(c_, v_)
+#define FS_CRC_8(c_, v_)    __crc32cb(c_, v_)
+#endif
+
+    FS_CRC_TARGET
+    uint32_t crcHardware(uint32_t crc, const uint8_t *src, std::size_t size)
+    {
+        uint64_t crc0 = crc;
+        for (; size >= 3 * crc_lane; src += 3 * crc_lane, size -= 3 * crc_lane)
+        {
+            uint64_t crc1 = 0,
+                     crc2 = 0;
+            for (std::size_t i = 0; i < crc_lane; i += 8)
+            {
+                crc0 = FS_CRC_64(static_cast<uint32_t>(crc0), load64(src + i));
+                crc1 = FS_CRC_64(static_cast<uint32_t>(crc1), load64(src + crc_lane + i));
+                crc2 = FS_CRC_64(static_cast<uint32_t>(crc2), load64(src + 2 * crc_lane + i));
+            }
+            crc0 = multModPoly(crc_lane_shift, static_cast<uint32_t>(crc0)) ^ crc1;
+            crc0 = multModPoly(crc_lane_shift, static_cast<uint32_t>(crc0)) ^ crc2;
+        }
+        for (; size >= 8; src += 8, size -= 8)
+        {
+            crc0 = FS_CRC_64(static_cast<uint32_t>(crc0), load64(src));
+        }
+        crc = static_cast<uint32_t>(crc0);
+        for (; size != 0; ++src, --size)
+        {
+            crc = FS_CRC_8(crc, *src);
+        }
+        return crc;
+    }
+
+#undef FS_CRC_TARGET
+#undef FS_CRC_64
+#undef FS_CRC_8
+#endif
+
+    using crc_kernel = uint32_t (*)(uint32_t, const uint8_t *, std::size_t);
+
+    crc_kernel pickCrcKernel()
+    {
+#if defined __x86_64__
+        return __builtin_cpu_supports("sse4.2") ? crcHardware : crcSoftware;
+#elif defined __aarch64__ && defined __ARM_FEATURE_CRC32
+        return crcHardware;
+#else
+        return crcSoftware;
+#endif
+    }
+
+    uint32_t crcUpdate(const uint32_t crc, const uint8_t *src, const std::size_t size)
+    {
+        static const crc_kernel kernel = pickCrcKernel();
+        return kernel(crc, src, size);
+    }
+
+    // xxHash64, as in the reference implementation
+    constexpr uint64_t xxh_prime1 = 11400714785074694791ull;
+    constexpr uint64_t xxh_prime2 = 14029467366897019727ull;
+    constexpr uint64_t xxh_prime3 = 1609587929392839161ull;
+    constexpr uint64_t xxh_prime4 = 9650029242287828579ull;
+    constexpr uint64_t xxh_prime5 = 2870177450012600261ull;
+
+    uint64_t rotl(const uint64_t value, const int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t xxhRound(uint64_t acc, const uint64_t input)
+    {
+        acc += input * xxh_prime2;
+        return rotl(acc, 31) * xxh_prime1;
+    }
+
+    uint64_t xxhMerge(const uint64_t acc, const uint64_t lane)
+    {
+        return (acc ^ xxhRound(0, lane)) * xxh_prime1 + xxh_prime4;
+    }
+
+    void xxhStripe(uint64_t *lanes, const uint8_t *src)
+    {
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            lanes[i] = xxhRound(lanes[i], load64(src + i * 8));
+        }
+    }
+}
+
+namespace fs
+{
+    void Hasher::reset()
+    {
+        m_total = 0;
+        if (m_algorithm == hash_algorithm::crc32c)
+        {
+            m_state[0] = 0xffffffffu;
+            return;
+        }
+        m_state[0] = xxh_prime1 + xxh_prime2;
+        m_state[1] = xxh_prime2;
+        m_state[2] = 0;
+        m_state[3] = 0 - xxh_prime1;
+    }
+
+    void Hasher::update(const void *data, std::size_t size)
+    {
+        auto *src = static_cast<const uint8_t *>(data);
+        if (m_algorithm == hash_algorithm::crc32c)
+        {
+            m_state[0] = crcUpdate(static_cast<uint32_t>(m_state[0]), src, size);
+            m_total   += size;
+            return;
+        }
+        // Whole 32 byte stripes go through the lanes, the rest waits in m_tail
+        const std::size_t used = static_cast<std::size_t>(m_total & 31);
+        m_total += size;
+        if (used + size < 32)
+        {
+            std::memcpy(m_tail + used, src, size);
+            return;
+        }
+        if (used != 0)
+        {
+            std::memcpy(m_tail + used, src, 32 - used);
+            xxhStripe(m_state, m_tail);
+            src  += 32 - used;
+            size -= 32 - used;
+        }
+        for (; size >= 32; src += 32, size -= 32)
+        {
+            xxhStripe(m_state, src);
+        }
+        std::memcpy(m_tail, src, size);
+    }
+
+    uint64_t Hasher::digest() const
+    {
+        if (m_algorithm == hash_algorithm::crc32c)
+        {
+            return ~static_cast<uint32_t>(m_state[0]);
+        }
+        uint64_t hash = m_total >= 32 ? rotl(m_state[0], 1) + rotl(m_state[1], 7) + rotl(m_state[2], 12) + rotl(m_state[3], 18)
+                                      : xxh_prime5;
+        if (m_total >= 32)
+        {
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                hash = xxhMerge(hash, m_state[i]);
+            }
+        }
+        hash += m_total;
+        const uint8_t *src = m_tail;
+        std::size_t size = static_cast<std::size_t>(m_total & 31);
+        for (; size >= 8; src += 8, size -= 8)
+        {
+            hash = rotl(hash ^ xxhRound(0, load64(src)), 27) * xxh_prime1 + xxh_prime4;
+        }
+        if (size >= 4)
+        {
+            hash = rotl(hash ^ (load32(src) * xxh_prime1), 23) * xxh_prime2 + xxh_prime3;
+            src  += 4;
+            size -= 4;
+        }
+        for (; size != 0; ++src, --size)
+        {
+            hash = rotl(hash ^ (*src * xxh_prime5), 11) * xxh_prime1;
+        }
+        hash ^= hash >> 33;
+        hash *= xxh_prime2;
+        hash ^= hash >> 29;
+        hash *= xxh_prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    uint64_t Hasher::hash(const hash_algorithm algorithm, const void *data, const std::size_t size)
+    {
+        Hasher hasher(algorithm);
+        hasher.update(data, size);
+        return hasher.digest();
+    }
+
+    uint32_t Hasher::crc32cCombine(const uint32_t first, const uint32_t second, const uint64_t secondSize)
+    {
+        return multModPoly(zerosOperator(secondSize), first) ^ second;
+    }
+}
+
+namespace
+{
+    // crc32c of a regular file, ChunkSize parts hashed on a pool and combined in order
+    bool hashParallelEx(const int fileHandle, const uint64_t fileSize, const std::size_t chunkSize, const unsigned threads, uint64_t &digest)
+    {
+        const std::size_t parts = static_cast<std::size_t>((fileSize + chunkSize - 1) / chunkSize);
+        std::vector<uint32_t> crcs(parts);
+        std::atomic<bool> ok { true };
+        {
+            fs::internal::WorkStealingPool pool(static_cast<unsigned>(std::min<std::size_t>(threads, parts)));
+            for (std::size_t i = 0; i < parts; ++i)
+            {
+                pool.spawn([&, i]
+                {
+                    thread_local fs::ReadBuffer buffer;
+                    const uint64_t    offset = i * static_cast<uint64_t>(chunkSize);
+                    const std::size_t length = static_cast<std::size_t>(std::min<uint64_t>(chunkSize, fileSize - offset));
+                    std::size_t read_bytes = 0;
+                    buffer.resizeForOverwrite(length);
+                    // A file that shrank since fstat has no well defined hash
+                    if (!ok.load(std::memory_order_relaxed) ||
+                        !fs::internal::preadFull(fileHandle, buffer.data(), length, offset, read_bytes) || read_bytes != length)
+                    {
+                        ok.store(false, std::memory_order_relaxed);
+                        return;
+                    }
+                    crcs[i] = static_cast<uint32_t>(fs::Hasher::hash(fs::hash_algorithm::crc32c, buffer.data(), length));
+                });
+            }
+            pool.wait();
+        }
+        if (!ok.load())
+        {
+            return false;
+        }
+        uint32_t crc = crcs[0];
+        for (std::size_t i = 1; i < parts; ++i)
+        {
+            crc = fs::Hasher::crc32cCombine(crc, crcs[i], std::min<uint64_t>(chunkSize, fileSize - i * static_cast<uint64_t>(chunkSize)));
+        }
+        digest = crc;
+        return true;
+    }
+
+    bool hashFileEx(const fs::path &filePath, uint64_t &digest, const fs::hash_options &options)
+    {
+        digest = 0;
+        int file_handle = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        struct stat stats;
+        if (fstat(file_handle, &stats) != 0 || S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        const std::size_t chunk_size = std::max<std::size_t>(options.ChunkSize, 64u << 10);
+        const unsigned    threads    = fs::internal::threadCount(options.Threads);
+        if (options.Algorithm == fs::hash_algorithm::crc32c && threads > 1 && S_ISREG(stats.st_mode) &&
+            static_cast<uint64_t>(stats.st_size) > chunk_size)
+        {
+            return hashParallelEx(file_handle, static_cast<uint64_t>(stats.st_size), chunk_size, threads, digest);
+        }
+        // Streamed through one chunk sized buffer, whatever the file size
+        posix_fadvise(file_handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+        fs::Hasher hasher(options.Algorithm);
+        fs::ReadBuffer buffer(chunk_size);
+        buffer.resizeForOverwrite(chunk_size);
+        std::size_t read_bytes = 0;
+        do
+        {
+            if (!fs::internal::readFull(file_handle, buffer.data(), chunk_size, read_bytes))
+            {
+                return false;
+            }
+            hasher.update(buffer.data(), read_bytes);
+        } while (read_bytes == chunk_size);
+        digest = hasher.digest();
+        return true;
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool hashFile(const fs::path &filePath, uint64_t &digest, const fs::hash_options &options)
+    {
+        return hashFileEx(filePath, digest, options);
+    }
+}
+#endif
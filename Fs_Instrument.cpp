@@ -0,0 +1,311 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+
+#if defined FS_INSTRUMENTATION
+#include <atomic>
+#include <thread>
+#endif
+
+namespace fs
+{
+    std::size_t latency_histogram::bucketOf(const uint64_t nanoseconds)
+    {
+        if (nanoseconds < sub_buckets)
+        {
+            return static_cast<std::size_t>(nanoseconds);
+        }
+        // Highest set bit picks the octave, the next three bits the bucket inside it
+        std::size_t exponent = 0;
+        for (uint64_t rest = nanoseconds; rest > 1; rest >>= 1)
+        {
+            ++exponent;
+        }
+        const std::size_t mantissa = static_cast<std::size_t>(nanoseconds >> (exponent - 3)) & (sub_buckets - 1);
+        return std::min((exponent - 2) * sub_buckets + mantissa, buckets - 1);
+    }
+
+    uint64_t latency_histogram::upperBound(const std::size_t bucket)
+    {
+        if (bucket < sub_buckets)
+        {
+            return bucket;
+        }
+        const std::size_t exponent = bucket / sub_buckets + 2;
+        const uint64_t    mantissa = bucket % sub_buckets;
+        return ((sub_buckets + mantissa + 1) << (exponent - 3)) - 1;
+    }
+
+    uint64_t latency_histogram::count() const
+    {
+        uint64_t total = 0;
+        for (const auto it : Counts)
+        {
+            total += it;
+        }
+        return total;
+    }
+
+    uint64_t latency_histogram::percentile(const double percent) const
+    {
+        const uint64_t total = count();
+        if (total == 0)
+        {
+            return 0;
+        }
+        const double   clamped  = std::min(std::max(percent, 0.0), 100.0);
+        const uint64_t rank     = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(total) + 0.5));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets; ++i)
+        {
+            seen += Counts[i];
+            if (seen >= rank)
+            {
+                return upperBound(i);
+            }
+        }
+        return upperBound(buckets - 1);
+    }
+}
+
+#if defined FS_INSTRUMENTATION
+namespace
+{
+    constexpr std::size_t op_count = static_cast<std::size_t>(fs::io_operation::count);
+
+    // Written by the owning thread only, so plain load + store instead of a locked add
+    struct OpCounters
+    {
+        std::atomic<uint64_t>   Calls   { 0 };
+        std::atomic<uint64_t>   Bytes   { 0 };
+        std::atomic<uint64_t>   Errors  { 0 };
+        std::atomic<uint64_t>   TotalNs { 0 };
+        std::array<std::atomic<uint64_t>, fs::latency_histogram::buckets> Latency {};
+    };
+
+    struct ThreadCounters
+    {
+        std::array<OpCounters, op_count> Ops;
+    };
+
+    void bump(std::atomic<uint64_t> &counter, const uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void addTo(fs::io_op_stats &total, const OpCounters &counters)
+    {
+        total.Calls     += counters.Calls.load(std::memory_order_relaxed);
+        total.Bytes     += counters.Bytes.load(std::memory_order_relaxed);
+        total.Errors    += counters.Errors.load(std::memory_order_relaxed);
+        total.TotalNs   += counters.TotalNs.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < fs::latency_histogram::buckets; ++i)
+        {
+            total.Latency.Counts[i] += counters.Latency[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void subtract(fs::io_op_stats &total, const fs::io_op_stats &base)
+    {
+        total.Calls     -= base.Calls;
+        total.Bytes     -= base.Bytes;
+        total.Errors    -= base.Errors;
+        total.TotalNs   -= base.TotalNs;
+        for (std::size_t i = 0; i < fs::latency_histogram::buckets; ++i)
+        {
+            total.Latency.Counts[i] -= base.Latency.Counts[i];
+        }
+    }
+
+    // Live threads plus what exited threads left behind. Reset only moves the
+    // baseline, so counters are never written by anyone but their owner.
+    struct Registry
+    {
+        std::mutex                      Lock;
+        std::vector<ThreadCounters *>   Live;
+        fs::io_stats                    Retired;
+        fs::io_stats                    Baseline;
+
+        fs::io_stats total()
+        {
+            fs::io_stats result = Retired;
+            for (const auto *it : Live)
+            {
+                for (std::size_t op = 0; op < op_count; ++op)
+                {
+                    addTo(result.Ops[op], it->Ops[op]);
+                }
+            }
+            return result;
+        }
+    };
+
+    // Never destroyed, threads may still exit during static destruction
+    Registry &registry()
+    {
+        static Registry *instance = new Registry;
+        return *instance;
+    }
+
+    struct ThreadSlot
+    {
+        ThreadSlot()
+        {
+            auto &reg = registry();
+            std::lock_guard<std::mutex> guard(reg.Lock);
+            reg.Live.push_back(&Counters);
+        }
+
+        ~ThreadSlot()
+        {
+            auto &reg = registry();
+            std::lock_guard<std::mutex> guard(reg.Lock);
+            for (std::size_t op = 0; op < op_count; ++op)
+            {
+                addTo(reg.Retired.Ops[op], Counters.Ops[op]);
+            }
+            reg.Live.erase(std::find(reg.Live.begin(), reg.Live.end(), &Counters));
+        }
+
+        ThreadCounters Counters;
+    };
+
+    // Hooks in use are guarded by a two phase grace period: a call counts itself
+    // in the reader slot of the current epoch before loading the hooks, and
+    // setTraceHooks frees the replaced ones only after both slots drained once.
+    std::atomic<const fs::trace_hooks *>    current_hooks   { nullptr };
+    std::atomic<uint32_t>                   hooks_epoch     { 0 };
+    std::array<std::atomic<uint64_t>, 2>    hooks_readers   {};
+
+    void waitForReaders(const uint32_t slot)
+    {
+        while (hooks_readers[slot].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+namespace fs::internal
+{
+    void recordIo(const fs::io_operation op, const uint64_t bytes, const bool success, const int64_t nanoseconds)
+    {
+        thread_local ThreadSlot slot;
+        auto &counters = slot.Counters.Ops[static_cast<std::size_t>(op)];
+        const uint64_t elapsed = static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0));
+        bump(counters.Calls, 1);
+        bump(counters.Bytes, bytes);
+        bump(counters.Errors, success ? 0 : 1);
+        bump(counters.TotalNs, elapsed);
+        bump(counters.Latency[fs::latency_histogram::bucketOf(elapsed)], 1);
+    }
+
+    const fs::trace_hooks *acquireTraceHooks(uint32_t &slot)
+    {
+        // Tracing off costs a single load, no shared counter is touched
+        if (!current_hooks.load(std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        slot = hooks_epoch.load() & 1;
+        hooks_readers[slot].fetch_add(1);
+        const fs::trace_hooks *hooks = current_hooks.load();
+        if (!hooks)
+        {
+            hooks_readers[slot].fetch_sub(1);
+        }
+        return hooks;
+    }
+
+    void releaseTraceHooks(const uint32_t slot)
+    {
+        hooks_readers[slot].fetch_sub(1, std::memory_order_release);
+    }
+
+    void recordCompleted(const fs::io_operation op, const fs::path *Path, const uint64_t bytes, const bool success, const int64_t nanoseconds)
+    {
+        recordIo(op, bytes, success, nanoseconds);
+        uint32_t slot = 0;
+        const fs::trace_hooks *hooks = acquireTraceHooks(slot);
+        if (!hooks)
+        {
+            return;
+        }
+        fs::io_span span;
+        span.Op     = op;
+        span.Path   = Path;
+        if (hooks->Begin)
+        {
+            hooks->Begin(span);
+        }
+        span.DurationNs = nanoseconds;
+        span.Bytes      = bytes;
+        span.Success    = success;
+        if (hooks->End)
+        {
+            hooks->End(span);
+        }
+        releaseTraceHooks(slot);
+    }
+}
+#endif
+
+namespace fs
+{
+#if defined FS_INSTRUMENTATION
+    LIB_EXPORT
+    fs::io_stats getIoStats()
+    {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.Lock);
+        fs::io_stats result = reg.total();
+        for (std::size_t op = 0; op < op_count; ++op)
+        {
+            subtract(result.Ops[op], reg.Baseline.Ops[op]);
+        }
+        result.Enabled = true;
+        return result;
+    }
+
+    LIB_EXPORT
+    void resetIoStats()
+    {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> guard(reg.Lock);
+        reg.Baseline = reg.total();
+    }
+
+    LIB_EXPORT
+    void setTraceHooks(const fs::trace_hooks &hooks)
+    {
+        static std::mutex lock;
+        std::lock_guard<std::mutex> guard(lock);
+        const fs::trace_hooks *replaced = current_hooks.exchange(hooks.Begin || hooks.End ? new fs::trace_hooks(hooks) : nullptr);
+        if (!replaced)
+        {
+            return;
+        }
+        // A call may have picked its slot before either flip, so both have to drain
+        for (int phase = 0; phase < 2; ++phase)
+        {
+            waitForReaders(hooks_epoch.fetch_add(1) & 1);
+        }
+        delete replaced;
+    }
+#else
+    LIB_EXPORT
+    fs::io_stats getIoStats()
+    {
+        return {};
+    }
+
+    LIB_EXPORT
+    void resetIoStats()
+    {
+    }
+
+    LIB_EXPORT
+    void setTraceHooks([[maybe_unused]] const fs::trace_hooks &hooks)
+    {
+    }
+#endif
+}
@@ -0,0 +1,124 @@
+#pragma once
+// Accounting behind the fs:: entry points, only built with FS_INSTRUMENTATION. Not part of the public api.
+#include "FsLib.h"
+
+// Returns call_. With FS_INSTRUMENTATION the call is timed and counted
+// under op_, bytes_ and ok_ may look at the returned result_.
+#if defined FS_INSTRUMENTATION
+#define FS_TRACED(op_, path_, call_, bytes_, ok_) \
+    { fs::internal::IoScope scope_(fs::io_operation::op_, path_); auto result_ = call_; scope_.finish(bytes_, ok_); return result_; }
+#else
+#define FS_TRACED(op_, path_, call_, bytes_, ok_) \
+    { return call_; }
+#endif
+
+#if defined FS_INSTRUMENTATION
+namespace fs::internal
+{
+    // Adds one call to the calling thread's counters
+    void recordIo(const fs::io_operation op, const uint64_t bytes, const bool success, const int64_t nanoseconds);
+    // Current hooks, null when tracing is off. Non-null hooks stay alive until
+    // releaseTraceHooks(slot), setTraceHooks waits for that before freeing them.
+    const fs::trace_hooks *acquireTraceHooks(uint32_t &slot);
+    void releaseTraceHooks(const uint32_t slot);
+    // Accounts a call that ran elsewhere (an AsyncIo request finishing on an i/o
+    // thread): counted on the calling thread, Begin and End are called back to back.
+    void recordCompleted(const fs::io_operation op, const fs::path *Path, const uint64_t bytes, const bool success, const int64_t nanoseconds);
+
+    // Times one entry point call. A scope left without finish() (exception) counts as an error.
+    class IoScope
+    {
+    public:
+        IoScope(const fs::io_operation op, const fs::path *Path)
+            : m_hooks(acquireTraceHooks(m_slot))
+        {
+            m_span.Op   = op;
+            m_span.Path = Path;
+            if (m_hooks && m_hooks->Begin)
+            {
+                m_hooks->Begin(m_span);
+            }
+            m_start = std::chrono::steady_clock::now();
+        }
+
+        IoScope(const IoScope &) = delete;
+        IoScope &operator=(const IoScope &) = delete;
+
+        ~IoScope()
+        {
+            if (!m_finished)
+            {
+                finish(0, false);
+            }
+        }
+
+        void finish(const uint64_t bytes, const bool success)
+        {
+            m_finished          = true;
+            m_span.DurationNs   = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+            m_span.Bytes        = bytes;
+            m_span.Success      = success;
+            recordIo(m_span.Op, bytes, success, m_span.DurationNs);
+            if (m_hooks)
+            {
+                if (m_hooks->End)
+                {
+                    m_hooks->End(m_span);
+                }
+                releaseTraceHooks(m_slot);
+                m_hooks = nullptr;
+            }
+        }
+
+    private:
+        uint32_t                                m_slot      = 0;
+        const fs::trace_hooks                  *m_hooks;
+        fs::io_span                             m_span;
+        std::chrono::steady_clock::time_point   m_start;
+        bool                                    m_finished  = false;
+    };
+
+    template<typename T>
+    uint64_t byteCount(const T &data)
+    {
+        return data.size() * sizeof(typename T::value_type);
+    }
+
+    inline uint64_t byteCount(const fs::ReadBuffer &data)
+    {
+        return data.size();
+    }
+
+#if !defined PLATFORM_WIN
+    inline uint64_t byteCount(const fs::MappedFile &data)
+    {
+        return data.size();
+    }
+
+    inline uint64_t byteCount(const std::vector<fs::io_result> &results)
+    {
+        uint64_t total = 0;
+        for (const auto &it : results)
+        {
+            total += it.Transferred;
+        }
+        return total;
+    }
+
+    inline uint64_t byteCount(const std::vector<fs::atomic_write> &files)
+    {
+        uint64_t total = 0;
+        for (const auto &it : files)
+        {
+            total += it.Data.size();
+        }
+        return total;
+    }
+
+    inline bool allSucceeded(const std::vector<fs::io_result> &results)
+    {
+        return std::all_of(results.begin(), results.end(), [](const fs::io_result &it) { return it.Success; });
+    }
+#endif
+}
+#endif
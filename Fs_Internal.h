@@ -0,0 +1,368 @@
+#pragma once
+// Helpers shared by the posix translation units, not part of the public api.
+#include "FsLib.h"
+
+#if !defined PLATFORM_WIN
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace fs::internal
+{
+    // read(2) until size bytes arrived or EOF, short reads and EINTR are retried
+    inline bool readFull(const int fileHandle, void *data, const std::size_t size, std::size_t &readBytes)
+    {
+        auto *dst = static_cast<uint8_t *>(data);
+        readBytes = 0;
+        while (readBytes < size)
+        {
+            const ssize_t res = read(fileHandle, dst + readBytes, size - readBytes);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            if (res == 0)
+            {
+                break;
+            }
+            readBytes += static_cast<std::size_t>(res);
+        }
+        return true;
+    }
+
+    // write(2) until everything is out, short writes and EINTR are retried
+    inline bool writeFull(const int fileHandle, const void *data, const std::size_t size)
+    {
+        const auto *src     = static_cast<const uint8_t *>(data);
+        std::size_t written = 0;
+        while (written < size)
+        {
+            const ssize_t res = write(fileHandle, src + written, size - written);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<std::size_t>(res);
+        }
+        return true;
+    }
+
+    // Positional variants, the file offset is left untouched
+    inline bool preadFull(const int fileHandle, void *data, const std::size_t size, const uint64_t offset, std::size_t &readBytes)
+    {
+        auto *dst = static_cast<uint8_t *>(data);
+        readBytes = 0;
+        while (readBytes < size)
+        {
+            const ssize_t res = pread(fileHandle, dst + readBytes, size - readBytes, static_cast<off_t>(offset + readBytes));
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            if (res == 0)
+            {
+                break;
+            }
+            readBytes += static_cast<std::size_t>(res);
+        }
+        return true;
+    }
+
+    inline bool pwriteFull(const int fileHandle, const void *data, const std::size_t size, const uint64_t offset)
+    {
+        const auto *src     = static_cast<const uint8_t *>(data);
+        std::size_t written = 0;
+        while (written < size)
+        {
+            const ssize_t res = pwrite(fileHandle, src + written, size - written, static_cast<off_t>(offset + written));
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<std::size_t>(res);
+        }
+        return true;
+    }
+
+    static_assert(sizeof(off_t) == 8, "64-bit file offsets required, build with _FILE_OFFSET_BITS=64");
+
+    // O_DIRECT wants buffer address, file offset and length aligned to the
+    // logical block size, 4 KiB covers every device around
+    constexpr std::size_t direct_alignment = 4096;
+
+    inline uint64_t alignDown(const uint64_t value)
+    {
+        return value & ~static_cast<uint64_t>(direct_alignment - 1);
+    }
+
+    inline uint64_t alignUp(const uint64_t value)
+    {
+        return alignDown(value + direct_alignment - 1);
+    }
+
+    // Aligned area of at least size bytes inside buffer. Contents are not kept
+    // when the buffer has to grow, buffer.size() is left alone.
+    inline std::byte *alignedData(fs::ReadBuffer &buffer, const std::size_t size)
+    {
+        if (buffer.capacity() < size + direct_alignment)
+        {
+            buffer.release();
+            buffer.reserve(size + direct_alignment);
+        }
+        const auto address = reinterpret_cast<uintptr_t>(buffer.data());
+        return buffer.data() + (alignUp(address) - address);
+    }
+
+    // preadFull for O_DIRECT handles: a short read that isn't block aligned is
+    // EOF, retrying from the unaligned offset would only get EINVAL
+    inline bool preadDirect(const int fileHandle, void *data, const std::size_t size, const uint64_t offset, std::size_t &readBytes)
+    {
+        auto *dst = static_cast<uint8_t *>(data);
+        readBytes = 0;
+        while (readBytes < size)
+        {
+            const ssize_t res = pread(fileHandle, dst + readBytes, size - readBytes, static_cast<off_t>(offset + readBytes));
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            readBytes += static_cast<std::size_t>(res);
+            if (res == 0 || readBytes % direct_alignment != 0)
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // open with O_DIRECT, plain open where the filesystem refuses it (tmpfs)
+    inline int openDirect(const char *path, const int flags, bool &direct, const mode_t mode = 0666)
+    {
+#if defined O_DIRECT
+        if (direct)
+        {
+            const int handle = ::open(path, flags | O_DIRECT, mode);
+            if (handle >= 0 || errno != EINVAL)
+            {
+                return handle;
+            }
+        }
+#endif
+        direct = false;
+        return ::open(path, flags, mode);
+    }
+
+    inline bool setDirect(const int fileHandle, const bool enable)
+    {
+#if defined O_DIRECT
+        const int flags = fcntl(fileHandle, F_GETFL);
+        return flags >= 0 && fcntl(fileHandle, F_SETFL, enable ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+#else
+        return !enable;
+#endif
+    }
+
+    inline void closeHandle(int &fileHandle)
+    {
+        if (fileHandle >= 0)
+        {
+            close(fileHandle);
+            fileHandle = -1;
+        }
+    }
+
+    // Keeps a read (or append) from touching the file times. Reads use
+    // O_NOATIME, writers snapshot atime / mtime right after open and put them
+    // back through the same fd in finish(). Both need the caller to own the
+    // file (or CAP_FOWNER): other callers get a plain open, there is no way
+    // around the kernel there.
+    struct SilentAccess
+    {
+        bool            Restore     = false;
+        struct timespec Times[2]    = {};       // atime, mtime
+
+        int open(const char *path, const int flags, const bool silent, const bool writing = false, const mode_t mode = 0666)
+        {
+            if (!silent)
+            {
+                return ::open(path, flags, mode);
+            }
+            if (!writing)
+            {
+                const int handle = ::open(path, flags | O_NOATIME, mode);
+                if (handle >= 0 || errno != EPERM)
+                {
+                    return handle;
+                }
+                return ::open(path, flags, mode);
+            }
+            const int handle = ::open(path, flags, mode);
+            struct stat stats;
+            if (handle >= 0 && fstat(handle, &stats) == 0)
+            {
+                Times[0] = stats.st_atim;
+                Times[1] = stats.st_mtim;
+                Restore  = true;
+            }
+            return handle;
+        }
+
+        // Before close, ctime still moves, nothing can be done about that
+        void finish(const int handle) const
+        {
+            if (Restore && handle >= 0)
+            {
+                futimens(handle, Times);
+            }
+        }
+    };
+
+    // Hashing reads / writes go through the data in pieces of this size, each
+    // is hashed right next to its I/O while it is still in cache
+    constexpr std::size_t hash_chunk_size = 1u << 20;
+
+    // readFull that feeds the hasher as the data arrives
+    inline bool readHashed(const int fileHandle, void *data, const std::size_t size, std::size_t &readBytes, fs::Hasher *hasher)
+    {
+        if (!hasher)
+        {
+            return readFull(fileHandle, data, size, readBytes);
+        }
+        auto *dst = static_cast<uint8_t *>(data);
+        std::size_t chunk = 0;
+        readBytes = 0;
+        while (readBytes < size)
+        {
+            const std::size_t piece = std::min(size - readBytes, hash_chunk_size);
+            if (!readFull(fileHandle, dst + readBytes, piece, chunk))
+            {
+                return false;
+            }
+            hasher->update(dst + readBytes, chunk);
+            readBytes += chunk;
+            if (chunk < piece)
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Whole contents of an open file, sized by st_size. procfs & co. report 0
+    // and are drained until EOF instead.
+    inline bool readHandle(const int fileHandle, const struct stat &stats, fs::ReadBuffer &data, fs::Hasher *hasher = nullptr)
+    {
+        std::size_t total = 0,
+                    chunk = 0;
+        data.resizeForOverwrite(static_cast<std::size_t>(stats.st_size));
+        if (!readHashed(fileHandle, data.data(), data.size(), total, hasher))
+        {
+            data.clear();
+            return false;
+        }
+        if (!S_ISREG(stats.st_mode) || stats.st_size == 0)
+        {
+            do
+            {
+                data.resizeForOverwrite(total + std::max<std::size_t>(4096, total / 2));
+                if (!readHashed(fileHandle, data.data() + total, data.size() - total, chunk, hasher))
+                {
+                    data.clear();
+                    return false;
+                }
+                total += chunk;
+            } while (total == data.size());
+        }
+        data.resizeForOverwrite(total);
+        return true;
+    }
+
+    inline fs::entry_type modeType(const mode_t mode)
+    {
+        if (S_ISREG(mode))
+        {
+            return fs::entry_type::file;
+        }
+        if (S_ISDIR(mode))
+        {
+            return fs::entry_type::directory;
+        }
+        if (S_ISLNK(mode))
+        {
+            return fs::entry_type::symlink;
+        }
+        return fs::entry_type::other;
+    }
+
+    inline unsigned threadCount(const unsigned requested)
+    {
+        return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Fork / join pool for tree shaped work. Tasks spawned from a worker go to
+    // the back of its own deque and are taken LIFO (depth first, few open
+    // directories), idle workers steal FIFO from the front of the others.
+    class WorkStealingPool
+    {
+    public:
+        using task = std::function<void()>;
+
+        explicit WorkStealingPool(const unsigned threads);
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+        ~WorkStealingPool();
+
+        void spawn(task work);
+        // Blocks until every spawned task, including the ones spawned by tasks, finished
+        void wait();
+        // Queued tasks are dropped, running ones finish
+        void cancel();
+
+    private:
+        struct Queue
+        {
+            std::mutex          Lock;
+            std::deque<task>    Tasks;
+        };
+
+        bool take(const unsigned self, task &work);
+        void workerLoop(const unsigned self);
+
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread>            m_threads;
+        std::mutex                          m_lock;
+        std::condition_variable             m_wake;
+        std::condition_variable             m_idle;
+        std::atomic<std::size_t>            m_queued    { 0 };
+        std::size_t                         m_pending   = 0;    // queued + running, under m_lock
+        std::atomic<unsigned>               m_next      { 0 };
+        bool                                m_stop      = false;
+    };
+}
+#endif
@@ -0,0 +1,212 @@
+#include "FsLib.h"
+
+#if defined PLATFORM_WIN
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include "Fs_Internal.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace
+{
+    constexpr int64_t ns_per_second = 1000000000;
+
+#if !defined PLATFORM_WIN
+    int64_t nanoseconds(const struct timespec &time)
+    {
+        return static_cast<int64_t>(time.tv_sec) * ns_per_second + time.tv_nsec;
+    }
+
+    void fromStat(const struct stat &stats, fs::metadata &result, const uint32_t fields)
+    {
+        result.Type         = fs::internal::modeType(stats.st_mode);
+        result.Mode         = stats.st_mode & 07777;
+        result.Uid          = stats.st_uid;
+        result.Gid          = stats.st_gid;
+        result.Links        = stats.st_nlink;
+        result.Device       = stats.st_dev;
+        result.Inode        = stats.st_ino;
+        result.Size         = static_cast<uint64_t>(stats.st_size);
+        result.AccessTime   = nanoseconds(stats.st_atim);
+        result.ModifyTime   = nanoseconds(stats.st_mtim);
+        result.ChangeTime   = nanoseconds(stats.st_ctim);
+        result.Valid        = fields & ~fs::metadata_field::btime;
+    }
+
+#if defined STATX_BASIC_STATS
+    int64_t nanoseconds(const struct statx_timestamp &time)
+    {
+        return time.tv_sec * ns_per_second + time.tv_nsec;
+    }
+
+    unsigned statxMask(const uint32_t fields)
+    {
+        unsigned mask = 0;
+        mask |= fields & fs::metadata_field::type   ? STATX_TYPE                : 0;
+        mask |= fields & fs::metadata_field::mode   ? STATX_MODE                : 0;
+        mask |= fields & fs::metadata_field::owner  ? STATX_UID | STATX_GID     : 0;
+        mask |= fields & fs::metadata_field::links  ? STATX_NLINK               : 0;
+        mask |= fields & fs::metadata_field::inode  ? STATX_INO                 : 0;
+        mask |= fields & fs::metadata_field::size   ? STATX_SIZE                : 0;
+        mask |= fields & fs::metadata_field::atime  ? STATX_ATIME               : 0;
+        mask |= fields & fs::metadata_field::mtime  ? STATX_MTIME               : 0;
+        mask |= fields & fs::metadata_field::ctime  ? STATX_CTIME               : 0;
+        mask |= fields & fs::metadata_field::btime  ? STATX_BTIME               : 0;
+        return mask;
+    }
+
+    // Only what the kernel reports in stx_mask ends up in Valid
+    void fromStatx(const struct statx &stats, fs::metadata &result, const uint32_t fields)
+    {
+        const unsigned got = stats.stx_mask;
+        auto take = [&](const uint32_t field, const unsigned bits)
+        {
+            const bool valid = (fields & field) && (got & bits) == bits;
+            result.Valid |= valid ? field : 0;
+            return valid;
+        };
+        if (take(fs::metadata_field::type, STATX_TYPE))
+        {
+            result.Type = fs::internal::modeType(stats.stx_mode);
+        }
+        if (take(fs::metadata_field::mode, STATX_MODE))
+        {
+            result.Mode = stats.stx_mode & 07777;
+        }
+        if (take(fs::metadata_field::owner, STATX_UID | STATX_GID))
+        {
+            result.Uid = stats.stx_uid;
+            result.Gid = stats.stx_gid;
+        }
+        if (take(fs::metadata_field::links, STATX_NLINK))
+        {
+            result.Links = stats.stx_nlink;
+        }
+        if (take(fs::metadata_field::inode, STATX_INO))
+        {
+            // Same encoding as st_dev, whichever of statx / fstatat ran
+            result.Device = makedev(stats.stx_dev_major, stats.stx_dev_minor);
+            result.Inode  = stats.stx_ino;
+        }
+        if (take(fs::metadata_field::size, STATX_SIZE))
+        {
+            result.Size = stats.stx_size;
+        }
+        if (take(fs::metadata_field::atime, STATX_ATIME))
+        {
+            result.AccessTime = nanoseconds(stats.stx_atime);
+        }
+        if (take(fs::metadata_field::mtime, STATX_MTIME))
+        {
+            result.ModifyTime = nanoseconds(stats.stx_mtime);
+        }
+        if (take(fs::metadata_field::ctime, STATX_CTIME))
+        {
+            result.ChangeTime = nanoseconds(stats.stx_ctime);
+        }
+        if (take(fs::metadata_field::btime, STATX_BTIME))
+        {
+            result.BirthTime = nanoseconds(stats.stx_btime);
+        }
+    }
+#endif
+
+    // One syscall, relative paths go to the kernel as they are
+    bool metadataEx(const fs::path &Path, fs::metadata &result, const uint32_t fields, const bool followLinks)
+    {
+        result = {};
+        const int nofollow = followLinks ? 0 : AT_SYMLINK_NOFOLLOW;
+#if defined STATX_BASIC_STATS
+        struct statx stats_x;
+        if (statx(AT_FDCWD, Path.c_str(), AT_STATX_SYNC_AS_STAT | nofollow, statxMask(fields), &stats_x) == 0)
+        {
+            fromStatx(stats_x, result, fields);
+            return true;
+        }
+        if (errno != ENOSYS)
+        {
+            return false;
+        }
+#endif
+        struct stat stats;
+        if (fstatat(AT_FDCWD, Path.c_str(), &stats, nofollow) != 0)
+        {
+            return false;
+        }
+        fromStat(stats, result, fields);
+        return true;
+    }
+#else
+    bool metadataEx(const fs::path &Path, fs::metadata &result, const uint32_t fields, [[maybe_unused]] const bool followLinks)
+    {
+        result = {};
+        const auto &working_path = Path.is_absolute() ? Path : fs::expandPath(Path);
+        struct _stat64 stats;
+        if (_wstat64(working_path.wstring().c_str(), &stats) != 0)
+        {
+            return false;
+        }
+        result.Type         = (stats.st_mode & _S_IFMT) == _S_IFDIR ? fs::entry_type::directory :
+                              (stats.st_mode & _S_IFMT) == _S_IFREG ? fs::entry_type::file : fs::entry_type::other;
+        result.Mode         = stats.st_mode & 0777;
+        result.Links        = static_cast<uint64_t>(stats.st_nlink);
+        result.Device       = stats.st_dev;
+        result.Size         = static_cast<uint64_t>(stats.st_size);
+        result.AccessTime   = stats.st_atime * ns_per_second;
+        result.ModifyTime   = stats.st_mtime * ns_per_second;
+        result.ChangeTime   = stats.st_ctime * ns_per_second;
+        result.Valid        = fields & (fs::metadata_field::type | fs::metadata_field::mode | fs::metadata_field::links |
+                                        fs::metadata_field::size | fs::metadata_field::atime | fs::metadata_field::mtime |
+                                        fs::metadata_field::ctime);
+        return true;
+    }
+#endif
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool getMetadata(const fs::path &Path, fs::metadata &result, const uint32_t fields, const bool followLinks)
+    {
+        return metadataEx(Path, result, fields, followLinks);
+    }
+
+#if !defined PLATFORM_WIN
+    // Paths are handed out in chunks so a sweep over millions of entries
+    // doesn't pay a task per stat. A failed entry keeps Valid == 0.
+    LIB_EXPORT
+    bool getMetadata(const std::vector<fs::path> &paths, std::vector<fs::metadata> &results, const uint32_t fields, const unsigned threads)
+    {
+        constexpr std::size_t chunk_size = 256;
+        results.assign(paths.size(), {});
+        std::atomic<bool> failed { false };
+        auto statRange = [&](const std::size_t first, const std::size_t last)
+        {
+            for (std::size_t i = first; i < last; ++i)
+            {
+                if (!metadataEx(paths[i], results[i], fields, true))
+                {
+                    results[i] = {};
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        };
+        const std::size_t chunks = (paths.size() + chunk_size - 1) / chunk_size;
+        if (chunks <= 1)
+        {
+            statRange(0, paths.size());
+            return !failed;
+        }
+        fs::internal::WorkStealingPool pool(std::min<unsigned>(fs::internal::threadCount(threads), static_cast<unsigned>(chunks)));
+        for (std::size_t first = 0; first < paths.size(); first += chunk_size)
+        {
+            pool.spawn([&, first] { statRange(first, std::min(first + chunk_size, paths.size())); });
+        }
+        pool.wait();
+        return !failed;
+    }
+#endif
+}
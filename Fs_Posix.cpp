@@ -1,4 +1,9 @@
 #include "FsLib.h"
+#include "Fs_Internal.h"
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
 
 #if defined PLATFORM_WIN
 #pragma warning (push)
@@ -6,8 +11,11 @@
 #else
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <limits.h>
@@ -50,51 +58,593 @@ namespace
     bool readFileEx(const fs::path &filePath, T &data, [[maybe_unused]] const bool silent)
     {
         const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+#if !defined PLATFORM_WIN
+        fs::internal::SilentAccess access;
+        int file_handle = access.open(working_path.c_str(), O_RDONLY | O_CLOEXEC, silent);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        fs::stat stats;
+        if (fstat(file_handle, &stats) != 0 || S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        // A file truncated under us comes back short instead of failing. /proc
+        // entries and pipes report 0, those are read until EOF.
+        const bool known_size = S_ISREG(stats.st_mode) && stats.st_size > 0;
+        std::size_t total = 0,
+                    chunk = 0;
+        data.resize(known_size ? static_cast<std::size_t>(stats.st_size) / sizeof(V) : 4096 / sizeof(V));
+        while (true)
+        {
+            auto *dst = reinterpret_cast<uint8_t *>(data.data());
+            const std::size_t capacity = data.size() * sizeof(V);
+            if (!fs::internal::readFull(file_handle, dst + total, capacity - total, chunk))
+            {
+                data.resize(0);
+                return false;
+            }
+            total += chunk;
+            if (known_size || total < capacity)
+            {
+                break;
+            }
+            data.resize(data.size() + std::max<std::size_t>(4096 / sizeof(V), data.size() / 2));
+        }
+        data.resize(total / sizeof(V));
+        return true;
+#else
         auto *file_handle = std::fopen(working_path.string().c_str(), "rb");
         if (!file_handle)
         {
             return false;
         }
-        std::fseek(file_handle, 0, SEEK_END);
-        const std::size_t file_size =
-#if defined PLATFORM_WIN
-            _ftelli64(file_handle);
-#else
-            ftello64(file_handle);
+        MakeScopeGuard([&] { std::fclose(file_handle); });
+        if (_fseeki64(file_handle, 0, SEEK_END) != 0)
+        {
+            return false;
+        }
+        const auto file_size = _ftelli64(file_handle);
+        if (file_size < 0 || _fseeki64(file_handle, 0, SEEK_SET) != 0)
+        {
+            return false;
+        }
+        const auto size_items = static_cast<std::size_t>(file_size) / sizeof(V);
+        std::size_t total = 0;
+        data.resize(size_items);
+        // fread may come back short before EOF, only a 0 with ferror is a failure
+        while (total < size_items)
+        {
+            const std::size_t res = std::fread(data.data() + total, sizeof(V), size_items - total, file_handle);
+            if (res == 0)
+            {
+                if (std::ferror(file_handle))
+                {
+                    data.resize(0);
+                    return false;
+                }
+                break;
+            }
+            total += res;
+        }
+        data.resize(total);
+        return true;
 #endif
-        const auto size_bytes = file_size / sizeof(V);
-        data.resize(size_bytes);
-        std::fseek(file_handle, 0, SEEK_SET);
-        return std::fread(&data[0], sizeof(V), size_bytes, file_handle) == size_bytes;
     }
 
     template<typename T, typename V = typename T::value_type>
     bool writeFileEx(const fs::path &filePath, const T &data, const bool force)
     {
         const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+        const std::size_t size_bytes = data.size() * sizeof(V);
+#if !defined PLATFORM_WIN
+        // Without force the data goes after the current contents
+        int file_handle = open(working_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (force ? O_TRUNC : O_APPEND), 0666);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        return force ? fs::internal::pwriteFull(file_handle, data.data(), size_bytes, 0)
+                     : fs::internal::writeFull(file_handle, data.data(), size_bytes);
+#else
         auto *file_handle = std::fopen(working_path.string().c_str(), force ? "wb" : "ab");
         if (!file_handle)
         {
             return false;
         }
         MakeScopeGuard([&] {if (file_handle) { std::fclose(file_handle); file_handle = nullptr; }});
-        const auto size_bytes = data.size() / sizeof(V);
-        return std::fwrite(&data[0], sizeof(V), size_bytes, file_handle) == size_bytes;
+        return size_bytes == 0 || std::fwrite(data.data(), 1, size_bytes, file_handle) == size_bytes;
+#endif
     }
 
     template<typename T, typename V = typename T::value_type>
     bool appendFileEx(const fs::path &filePath, const T &data, [[maybe_unused]] const bool silent)
     {
         const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+#if !defined PLATFORM_WIN
+        fs::internal::SilentAccess access;
+        int file_handle = access.open(working_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, silent, true);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        return fs::internal::writeFull(file_handle, data.data(), data.size() * sizeof(V));
+#else
         auto *file_handle = std::fopen(working_path.string().c_str(), "ab");
         if (!file_handle)
         {
             return false;
         }
         MakeScopeGuard([&] {if (file_handle) { std::fclose(file_handle); file_handle = nullptr; }});
-        const auto size_bytes = data.size() / sizeof(V);
-        return std::fwrite(&data[0], sizeof(V), size_bytes, file_handle) == size_bytes;
+        const std::size_t size_bytes = data.size() * sizeof(V);
+        return size_bytes == 0 || std::fwrite(data.data(), 1, size_bytes, file_handle) == size_bytes;
+#endif
+    }
+
+#if !defined PLATFORM_WIN
+    int mapAdvice(const fs::map_advice advice)
+    {
+        switch (advice)
+        {
+        case fs::map_advice::sequential:    return MADV_SEQUENTIAL;
+        case fs::map_advice::random:        return MADV_RANDOM;
+        case fs::map_advice::willneed:      return MADV_WILLNEED;
+        case fs::map_advice::dontneed:      return MADV_DONTNEED;
+#if defined MADV_HUGEPAGE
+        case fs::map_advice::hugepage:      return MADV_HUGEPAGE;
+#endif
+        default:                            return MADV_NORMAL;
+        }
+    }
+
+    int openReadEx(const fs::path &filePath, fs::stat &stats, const bool silent, fs::internal::SilentAccess &access)
+    {
+        const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+        int file_handle = access.open(working_path.c_str(), O_RDONLY | O_CLOEXEC, silent);
+        if (file_handle < 0)
+        {
+            return -1;
+        }
+        if (fstat(file_handle, &stats) != 0 || S_ISDIR(stats.st_mode))
+        {
+            access.finish(file_handle);
+            close(file_handle);
+            return -1;
+        }
+        return file_handle;
+    }
+
+    bool readBufferEx(const fs::path &filePath, fs::ReadBuffer &data, const bool silent)
+    {
+        fs::stat stats;
+        fs::internal::SilentAccess access;
+        int file_handle = openReadEx(filePath, stats, silent, access);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        return fs::internal::readHandle(file_handle, stats, data);
+    }
+
+    bool readIntoEx(const fs::path &filePath, void *data, const std::size_t capacity, std::size_t &readBytes, const bool silent)
+    {
+        fs::stat stats;
+        fs::internal::SilentAccess access;
+        readBytes = 0;
+        int file_handle = openReadEx(filePath, stats, silent, access);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        if (S_ISREG(stats.st_mode) && static_cast<std::size_t>(stats.st_size) > capacity)
+        {
+            // Report the required size so the caller can grow its buffer
+            readBytes = static_cast<std::size_t>(stats.st_size);
+            errno = EOVERFLOW;
+            return false;
+        }
+        if (!fs::internal::readFull(file_handle, data, capacity, readBytes))
+        {
+            return false;
+        }
+        if (readBytes < capacity)
+        {
+            return true;
+        }
+        // Full buffer: pipes, /proc and files that grew may hold more than fits
+        uint8_t extra = 0;
+        ssize_t res = 0;
+        while ((res = ::read(file_handle, &extra, 1)) < 0 && errno == EINTR)
+        {
+        }
+        if (res != 0)
+        {
+            if (res > 0)
+            {
+                errno = EOVERFLOW;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    bool readVerifiedEx(const fs::path &filePath, fs::ReadBuffer &data, const fs::checksum &expected, const bool silent)
+    {
+        fs::stat stats;
+        fs::internal::SilentAccess access;
+        int file_handle = openReadEx(filePath, stats, silent, access);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { access.finish(file_handle); fs::internal::closeHandle(file_handle); });
+        fs::Hasher hasher(expected.Algorithm);
+        if (!fs::internal::readHandle(file_handle, stats, data, &hasher))
+        {
+            return false;
+        }
+        if (hasher.digest() != expected.Value)
+        {
+            data.clear();
+            errno = EBADMSG;
+            return false;
+        }
+        return true;
+    }
+
+    // writeFileEx hashing each piece right before it goes out
+    bool writeHashedEx(const fs::path &filePath, const void *data, const std::size_t size, fs::checksum &result, const bool force)
+    {
+        const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+        result.Value = 0;
+        int file_handle = open(working_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (force ? O_TRUNC : O_APPEND), 0666);
+        if (file_handle < 0)
+        {
+            return false;
+        }
+        MakeScopeGuard([&] { fs::internal::closeHandle(file_handle); });
+        fs::Hasher hasher(result.Algorithm);
+        const auto *src = static_cast<const uint8_t *>(data);
+        for (std::size_t done = 0; done < size;)
+        {
+            const std::size_t piece = std::min(size - done, fs::internal::hash_chunk_size);
+            hasher.update(src + done, piece);
+            if (!(force ? fs::internal::pwriteFull(file_handle, src + done, piece, done)
+                        : fs::internal::writeFull(file_handle, src + done, piece)))
+            {
+                return false;
+            }
+            done += piece;
+        }
+        result.Value = hasher.digest();
+        return true;
+    }
+
+    // Directory being emptied by RemoveTree. Its DIR (and through Parent the
+    // parent's) stays open until the last subdirectory is gone, so all the
+    // unlinks are relative to directory fds instead of full path lookups.
+    struct RemoveNode
+    {
+        std::shared_ptr<RemoveNode> Parent;
+        std::string                 Name;
+        DIR                        *Handle  = nullptr;
+        std::atomic<std::size_t>    Pending { 1 };      // own enumeration + live subdirectories
+
+        ~RemoveNode()
+        {
+            if (Handle)
+            {
+                closedir(Handle);
+            }
+        }
+    };
+
+    struct RemoveTree
+    {
+        // No pool for a single thread, the caller works through Stack itself
+        std::unique_ptr<fs::internal::WorkStealingPool> Pool;
+        std::vector<std::shared_ptr<RemoveNode>>        Stack;      // LIFO like the pool: depth first, few open DIRs
+        const fs::path                                  Root;
+        const bool                                      StopOnError;
+        std::atomic<bool>                               Failed  { false };
+
+        RemoveTree(const fs::path &root, const fs::remove_options &options)
+            : Root(root), StopOnError(options.StopOnError)
+        {
+            const unsigned threads = fs::internal::threadCount(options.Threads);
+            if (threads > 1)
+            {
+                Pool = std::make_unique<fs::internal::WorkStealingPool>(threads);
+            }
+        }
+
+        void run()
+        {
+            auto root = std::make_shared<RemoveNode>();
+            if (Pool)
+            {
+                Pool->spawn([this, root] { process(root); });
+                Pool->wait();
+                return;
+            }
+            Stack.push_back(std::move(root));
+            while (!Stack.empty() && !stopped())
+            {
+                const auto node = std::move(Stack.back());
+                Stack.pop_back();
+                process(node);
+            }
+        }
+
+        void spawn(std::shared_ptr<RemoveNode> node)
+        {
+            if (Pool)
+            {
+                Pool->spawn([this, node] { process(node); });
+            }
+            else
+            {
+                Stack.push_back(std::move(node));
+            }
+        }
+
+        void fail()
+        {
+            Failed.store(true, std::memory_order_relaxed);
+            if (StopOnError && Pool)
+            {
+                Pool->cancel();
+            }
+        }
+
+        bool stopped() const
+        {
+            return StopOnError && Failed.load(std::memory_order_relaxed);
+        }
+
+        void process(const std::shared_ptr<RemoveNode> &node)
+        {
+            if (stopped())
+            {
+                return;
+            }
+            const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+            int dir_handle = node->Parent ? openat(dirfd(node->Parent->Handle), node->Name.c_str(), flags)
+                                          : open(Root.c_str(), flags);
+            if (dir_handle < 0 || !(node->Handle = fdopendir(dir_handle)))
+            {
+                fs::internal::closeHandle(dir_handle);
+                fail();
+                return;
+            }
+            struct dirent *it_file = nullptr;
+            while ((it_file = readdir(node->Handle)) != nullptr)
+            {
+                const char *name = it_file->d_name;
+                if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+                {
+                    continue;
+                }
+                // d_type saves a stat per entry, only some filesystems leave it unknown
+                bool is_dir = it_file->d_type == DT_DIR;
+                if (it_file->d_type == DT_UNKNOWN)
+                {
+                    fs::stat stats;
+                    is_dir = fstatat(dir_handle, name, &stats, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(stats.st_mode);
+                }
+                if (!is_dir)
+                {
+                    if (unlinkat(dir_handle, name, 0) == 0)
+                    {
+                        continue;
+                    }
+                    if (errno != EISDIR)
+                    {
+                        fail();
+                        if (stopped())
+                        {
+                            return;
+                        }
+                        continue;
+                    }
+                }
+                auto child = std::make_shared<RemoveNode>();
+                child->Parent = node;
+                child->Name   = name;
+                node->Pending.fetch_add(1, std::memory_order_relaxed);
+                spawn(std::move(child));
+            }
+            finish(node);
+        }
+
+        // Drops one reference from node, removing every directory up the chain that became empty
+        void finish(std::shared_ptr<RemoveNode> node)
+        {
+            while (node && node->Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                closedir(node->Handle);
+                node->Handle = nullptr;
+                const int res = node->Parent ? unlinkat(dirfd(node->Parent->Handle), node->Name.c_str(), AT_REMOVEDIR)
+                                             : rmdir(Root.c_str());
+                if (res != 0)
+                {
+                    fail();
+                    if (stopped())
+                    {
+                        return;
+                    }
+                }
+                node = node->Parent;
+            }
+        }
+    };
+
+    const std::list<fs::path> enumDirEx(const fs::path &Path, const fs::NameFilter &filter)
+    {
+        std::list<fs::path> result;
+        fs::walk_options options;
+        options.MaxDepth = 1;
+        options.Filter   = filter;
+        fs::posix::walk(Path, [&](const fs::walk_entry &entry)
+            {
+                result.push_back(Path / entry.Name);
+                return fs::walk_action::next;
+            }, options);
+        return result;
+    }
+
+    bool removeTreeEx(const fs::path &Path, const fs::remove_options &options)
+    {
+        fs::stat stats;
+        if (lstat(Path.c_str(), &stats) != 0)
+        {
+            // Same as removeDir, nothing to remove is fine
+            return errno == ENOENT;
+        }
+        if (!S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        RemoveTree tree(Path, options);
+        tree.run();
+        return !tree.Failed.load();
     }
+#endif
+
+#if !defined PLATFORM_WIN
+    // True when value is prefix itself or lies below it
+    bool underPath(const std::string &value, const std::string &prefix)
+    {
+        return value.compare(0, prefix.size(), prefix) == 0 &&
+              (value.size() == prefix.size() || prefix.back() == '/' || value[prefix.size()] == '/');
+    }
+
+    // LRU of expandPath results, relative paths are keyed as "<cwd>\0<path>"
+    class PathCache
+    {
+    public:
+        void configure(const fs::path_cache_options &options)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_options = options;
+            m_entries.clear();
+            m_order.clear();
+            m_enabled = options.Enabled && options.Capacity != 0;
+        }
+
+        // key is left empty while the cache is off, store() ignores those
+        bool lookup(const fs::path &Path, std::string &key, fs::path &result)
+        {
+            if (!m_enabled.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            if (Path.is_relative())
+            {
+                char cwd[PATH_MAX];
+                if (!getcwd(cwd, sizeof(cwd)))
+                {
+                    return false;
+                }
+                key.assign(cwd).push_back('\0');
+            }
+            key += Path.native();
+            std::lock_guard<std::mutex> guard(m_lock);
+            const auto it = m_entries.find(key);
+            if (it == m_entries.end())
+            {
+                return false;
+            }
+            if (m_options.Ttl.count() != 0 && std::chrono::steady_clock::now() >= it->second.Expires)
+            {
+                m_order.erase(it->second.Order);
+                m_entries.erase(it);
+                return false;
+            }
+            m_order.splice(m_order.begin(), m_order, it->second.Order);
+            result = it->second.Value;
+            return true;
+        }
+
+        void store(const std::string &key, const fs::path &value)
+        {
+            if (key.empty())
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (!m_enabled.load(std::memory_order_relaxed) || m_entries.count(key))
+            {
+                return;
+            }
+            while (m_entries.size() >= m_options.Capacity)
+            {
+                m_entries.erase(m_order.back());
+                m_order.pop_back();
+            }
+            m_order.push_front(key);
+            auto &entry   = m_entries[key];
+            entry.Value   = value;
+            entry.Expires = std::chrono::steady_clock::now() + m_options.Ttl;
+            entry.Order   = m_order.begin();
+        }
+
+        // Drops entries resolving to, or spelled as, Path or anything below it
+        void invalidate(const fs::path &Path)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (Path.empty())
+            {
+                m_entries.clear();
+                m_order.clear();
+                return;
+            }
+            std::error_code err;
+            const auto prefix = std::filesystem::absolute(Path, err).lexically_normal().native();
+            for (auto it = m_entries.begin(); it != m_entries.end();)
+            {
+                const auto split = it->first.find('\0');
+                const auto spelled = split == std::string::npos ? fs::path(it->first)
+                                                                : fs::path(it->first.substr(0, split)) / it->first.substr(split + 1);
+                if (underPath(it->second.Value.native(), prefix) || underPath(spelled.lexically_normal().native(), prefix))
+                {
+                    m_order.erase(it->second.Order);
+                    it = m_entries.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            fs::path                                Value;
+            std::chrono::steady_clock::time_point   Expires;
+            std::list<std::string>::iterator        Order;
+        };
+
+        std::atomic<bool>                       m_enabled   { false };
+        std::mutex                              m_lock;
+        fs::path_cache_options                  m_options;
+        std::unordered_map<std::string, Entry>  m_entries;
+        std::list<std::string>                  m_order;    // most recently used first
+    };
+
+    PathCache &pathCache()
+    {
+        static PathCache cache;
+        return cache;
+    }
+#endif
 
     int statsEx(const fs::path &filePath, fs::stat &statRes)
     {
@@ -116,6 +666,14 @@ namespace fs::posix
     LIB_EXPORT
     const fs::path expandPath(const fs::path &Path)
     {
+#if !defined PLATFORM_WIN
+        std::string cache_key;
+        fs::path cached;
+        if (pathCache().lookup(Path, cache_key, cached))
+        {
+            return cached;
+        }
+#endif
 #if defined PLATFORM_WIN
         wchar_t 
 #else
@@ -128,9 +686,33 @@ namespace fs::posix
 #else
         temp_path = canonicalize_file_name(Path.string().c_str());
 #endif
-        return fs::path(temp_path);
+        if (!temp_path)
+        {
+            // Nothing to resolve yet (e.g. a file about to be created), fall back to a lexical full path
+            std::error_code err;
+            return std::filesystem::absolute(Path, err).lexically_normal();
+        }
+        fs::path result(temp_path);
+#if !defined PLATFORM_WIN
+        pathCache().store(cache_key, result);
+#endif
+        return result;
+    }
+
+#if !defined PLATFORM_WIN
+    LIB_EXPORT
+    void setPathCache(const fs::path_cache_options &options)
+    {
+        pathCache().configure(options);
     }
 
+    LIB_EXPORT
+    void invalidatePathCache(const fs::path &Path)
+    {
+        pathCache().invalidate(Path);
+    }
+#endif
+
     LIB_EXPORT
     bool isExist(const fs::path &Path)
     {
@@ -144,7 +726,7 @@ namespace fs::posix
     {
         fs::stat stats;
         const auto res = statsEx(Path, stats);
-        return res == 0 && stats.st_mode == S_IFDIR;
+        return res == 0 && (stats.st_mode & S_IFMT) == S_IFDIR;
     }
 
     LIB_EXPORT
@@ -160,11 +742,11 @@ namespace fs::posix
         {
             return false;
         }
-        if (stats.st_mode == S_IFLNK)
+        if ((stats.st_mode & S_IFMT) == S_IFLNK)
         {
             return unlink(filePath.string().c_str()) == 0;
         }
-        else if (stats.st_mode == S_IFMT)
+        else if ((stats.st_mode & S_IFMT) != S_IFDIR)
         {
             return remove(filePath.string().c_str()) == 0;
         }
@@ -185,6 +767,10 @@ namespace fs::posix
         }
         if (recursive)
         {
+#if !defined PLATFORM_WIN
+            // fd relative walk, symlinks are unlinked and never followed out of the tree
+            return removeTreeEx(working_path, fs::remove_options{ 1, true });
+#else
             bool res = true;
             const auto &folder_contnt = fs::enumDir(working_path);
             for (const auto &it : folder_contnt)
@@ -202,7 +788,7 @@ namespace fs::posix
                     return res;
                 }
             }
-
+#endif
         }
 
         const int reuslt =
@@ -219,7 +805,7 @@ namespace fs::posix
     {
         const auto &working_path = Path.is_absolute() ? Path : fs::expandPath(Path);
         bool result = true;
-        if (!isExist(Path.parent_path()))
+        if (Path.has_parent_path() && !isExist(Path.parent_path()))
         {
             if (!recirsive)
             {
@@ -233,7 +819,8 @@ namespace fs::posix
 #if defined PLATFORM_WIN64 || defined PLATFORM_WIN32
         result &= _wmkdir(Path.wstring().c_str()) == 0;
 #else
-        result &= mkdir(Path.string().c_str(),  S_IRWXU | S_IRWXG | S_IRWXO) == 0;
+        // Someone else creating the same tree concurrently is fine
+        result &= mkdir(Path.string().c_str(),  S_IRWXU | S_IRWXG | S_IRWXO) == 0 || (errno == EEXIST && isDirectory(Path));
 #endif
         return result;
     }
@@ -243,44 +830,171 @@ namespace fs::posix
     LIB_EXPORT
     const std::list<fs::path> enumDir(const fs::path &Path, const std::string &regFilter)
     {
-        const auto &working_path = Path.is_absolute() ? Path : fs::expandPath(Path);
-        if (working_path.empty())
+        // Compiled once for the whole listing
+        return enumDirEx(Path, fs::NameFilter::regex(regFilter));
+    }
+
+    LIB_EXPORT
+    const std::list<fs::path> enumDir(const fs::path &Path, const fs::NameFilter &filter)
+    {
+        return enumDirEx(Path, filter);
+    }
+#else
+    LIB_EXPORT
+    const std::list<fs::path> enumDir(const fs::path &Path, const std::string &regFilter)
+    {
+        return {};
+    }
+#endif
+
+#if !defined PLATFORM_WIN
+    LIB_EXPORT
+    fs::MappedFile mapFile(const fs::path &filePath, const fs::map_options &options)
+    {
+        const auto &working_path = filePath.is_absolute() ? filePath : fs::expandPath(filePath);
+        int file_handle = open(working_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file_handle < 0)
         {
             return {};
         }
-        if (!isDirectory(working_path))
+        MakeScopeGuard([&] { if (file_handle >= 0) { close(file_handle); file_handle = -1; } });
+        fs::stat stats;
+        if (fstat(file_handle, &stats) != 0 || !S_ISREG(stats.st_mode))
         {
             return {};
         }
-                  DIR *h_dir   = nullptr;
-        struct dirent *it_file = nullptr;
-        std::list<fs::path> result;
-        if (!(h_dir = opendir(working_path.string().c_str())))
+        // mmap refuses zero length, an empty file is still a valid (empty) view
+        if (stats.st_size == 0)
+        {
+            return fs::MappedFile(nullptr, 0);
+        }
+        const std::size_t map_size = static_cast<std::size_t>(stats.st_size);
+        const int flags = MAP_PRIVATE | (options.Populate ? MAP_POPULATE : 0);
+        void *address = mmap(nullptr, map_size, PROT_READ, flags, file_handle, 0);
+        if (address == MAP_FAILED)
         {
             return {};
         }
-        MakeScopeGuard([&] { if (h_dir) { closedir(h_dir); h_dir = nullptr; } });
-        while ((it_file = readdir(h_dir)) != NULL)
+        fs::MappedFile result(address, map_size);
+        if (options.Advice != fs::map_advice::normal)
         {
-            std::string file_name(it_file->d_name);
-            if ((file_name == "." && file_name.size() == 1) || (file_name == ".." && file_name.size() == 2) ||
-               (!regFilter.empty() && !std::regex_match(file_name, std::regex(regFilter))) )
-            {
-                continue;
-            }
-            result.push_back(Path / it_file->d_name);
+            // Only a hint, the view is usable either way
+            result.advise(options.Advice);
         }
         return result;
     }
-#else
+
     LIB_EXPORT
-    const std::list<fs::path> enumDir(const fs::path &Path, const std::string &regFilter)
+    bool readFile(const fs::path &filePath, fs::ReadBuffer &data, const bool silent)
     {
-        return {};
+        return readBufferEx(filePath, data, silent);
+    }
+
+    LIB_EXPORT
+    bool readFile(const fs::path &filePath, void *data, const std::size_t capacity, std::size_t &readBytes, const bool silent)
+    {
+        return readIntoEx(filePath, data, capacity, readBytes, silent);
     }
+
+    LIB_EXPORT
+    bool readFile(const fs::path &filePath, fs::ReadBuffer &data, const fs::checksum &expected, const bool silent)
+    {
+        return readVerifiedEx(filePath, data, expected, silent);
+    }
+
+    LIB_EXPORT
+    bool writeFile(const fs::path &filePath, std::string_view data, fs::checksum &result, const bool force)
+    {
+        return writeHashedEx(filePath, data.data(), data.size(), result, force);
+    }
+
+    LIB_EXPORT
+    bool writeFile(const fs::path &filePath, const std::vector<uint8_t> &data, fs::checksum &result, const bool force)
+    {
+        return writeHashedEx(filePath, data.data(), data.size(), result, force);
+    }
+
+    LIB_EXPORT
+    bool removeDir(const fs::path &Path, const fs::remove_options &options)
+    {
+        return removeTreeEx(Path, options);
+    }
+
+#if defined IS_CPP_20G
+    LIB_EXPORT
+    bool readFile(const fs::path &filePath, std::span<std::byte> data, std::size_t &readBytes, const bool silent)
+    {
+        return readIntoEx(filePath, data.data(), data.size(), readBytes, silent);
+    }
+
+    LIB_EXPORT
+    bool writeFile(const fs::path &filePath, std::span<const std::byte> data, fs::checksum &result, const bool force)
+    {
+        return writeHashedEx(filePath, data.data(), data.size(), result, force);
+    }
+#endif
 #endif
 }
 
+#if !defined PLATFORM_WIN
+namespace fs
+{
+    MappedFile::MappedFile(void *address, std::size_t size)
+        : m_data(static_cast<const std::byte *>(address)), m_size(size), m_valid(true)
+    {
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+        : m_data(other.m_data), m_size(other.m_size), m_valid(other.m_valid)
+    {
+        other.m_data  = nullptr;
+        other.m_size  = 0;
+        other.m_valid = false;
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            std::swap(m_valid, other.m_valid);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        reset();
+    }
+
+    bool MappedFile::advise(const map_advice advice, const std::size_t offset, const std::size_t length) const
+    {
+        if (!m_data || offset >= m_size)
+        {
+            return false;
+        }
+        // madvise wants a page aligned start
+        static const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t aligned_offset = offset - (offset % page_size);
+        const std::size_t end = (length == 0 || length > m_size - offset) ? m_size : offset + length;
+        return madvise(const_cast<std::byte *>(m_data) + aligned_offset, end - aligned_offset, mapAdvice(advice)) == 0;
+    }
+
+    void MappedFile::reset()
+    {
+        if (m_data)
+        {
+            munmap(const_cast<std::byte *>(m_data), m_size);
+        }
+        m_data  = nullptr;
+        m_size  = 0;
+        m_valid = false;
+    }
+}
+#endif
+
 #endif
 
 #if defined PLATFORM_WIN
@@ -1,4 +1,9 @@
 #include "FsLib.h"
+#include "Fs_Instrument.h"
+
+#undef DEFINE_FUNCTION_RESOLVED_BODY
+#define DEFINE_FUNCTION_RESOLVED_BODY( pref_ , post_ , arg_ ) \
+    FS_TRACED(pref_, &filePath, FS_APENDIX::pref_##post_(filePath, data, arg_), result_ ? fs::internal::byteCount(data) : 0, result_)
 
 #if defined IS_CPP_20G
 #define DEFINE_RESOLVER_OUT_OPS_20(name_ , _arg) \
@@ -44,21 +49,118 @@
     DEFINE_RESOLVER_OUT_OPS(append, silent) \
     DEFINE_RESOLVER_IN_OPS_14(read, silent) \
     LIB_EXPORT const fs::path               expandPath(const fs::path &Path)    \
-        { return FS_APENDIX::expandPath(Path); } \
+        FS_TRACED(expand_path, &Path, FS_APENDIX::expandPath(Path), 0, !result_.empty()) \
     LIB_EXPORT bool                         removeFile(const fs::path &filePath)    \
-        { return FS_APENDIX::removeFile(filePath); } \
+        FS_TRACED(remove_file, &filePath, FS_APENDIX::removeFile(filePath), 0, result_) \
     LIB_EXPORT bool                         removeDir(const fs::path &Path, const bool recursive)    \
-        { return FS_APENDIX::removeDir(Path, recursive); } \
+        FS_TRACED(remove_dir, &Path, FS_APENDIX::removeDir(Path, recursive), 0, result_) \
     LIB_EXPORT bool                         isDirectory(const fs::path &Path)   \
-        { return FS_APENDIX::isDirectory(Path); } \
+        FS_TRACED(stat, &Path, FS_APENDIX::isDirectory(Path), 0, true) \
     LIB_EXPORT bool                         isExist(const fs::path &Path)   \
-        { return FS_APENDIX::isExist(Path); } \
+        FS_TRACED(stat, &Path, FS_APENDIX::isExist(Path), 0, true) \
     LIB_EXPORT bool                         createDirectory(const fs::path &Path, const bool recirsive) \
-        { return FS_APENDIX::createDirectory(Path, recirsive); } \
+        FS_TRACED(create_directory, &Path, FS_APENDIX::createDirectory(Path, recirsive), 0, result_) \
     LIB_EXPORT const std::list<fs::path>    enumDir(const fs::path &Path, const std::string &regFilter) \
-        { return FS_APENDIX::enumDir(Path, regFilter); }
+        FS_TRACED(enum_dir, &Path, FS_APENDIX::enumDir(Path, regFilter), 0, true) \
+    LIB_EXPORT bool                         getMetadata(const fs::path &Path, fs::metadata &result, const uint32_t fields, const bool followLinks) \
+        FS_TRACED(stat, &Path, FS_APENDIX::getMetadata(Path, result, fields, followLinks), 0, result_)
+
+#if !defined PLATFORM_WIN
+#define DEFINE_POSIX_EXT_BODY_FS() \
+    LIB_EXPORT fs::MappedFile               mapFile(const fs::path &filePath, const fs::map_options &options) \
+        FS_TRACED(map, &filePath, posix::mapFile(filePath, options), fs::internal::byteCount(result_), static_cast<bool>(result_)) \
+    LIB_EXPORT bool                         readFile(const fs::path &filePath, fs::ReadBuffer &data, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readFile(filePath, data, silent), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         readFile(const fs::path &filePath, void *data, const std::size_t capacity, std::size_t &readBytes, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readFile(filePath, data, capacity, readBytes, silent), result_ ? readBytes : 0, result_) \
+    LIB_EXPORT bool                         readFile(const fs::path &filePath, fs::ReadBuffer &data, const fs::checksum &expected, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readFile(filePath, data, expected, silent), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFile(const fs::path &filePath, std::string_view data, fs::checksum &result, const bool force) \
+        FS_TRACED(write, &filePath, posix::writeFile(filePath, data, result, force), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFile(const fs::path &filePath, const std::vector<uint8_t> &data, fs::checksum &result, const bool force) \
+        FS_TRACED(write, &filePath, posix::writeFile(filePath, data, result, force), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         hashFile(const fs::path &filePath, uint64_t &digest, const fs::hash_options &options) \
+        FS_TRACED(hash, &filePath, posix::hashFile(filePath, digest, options), 0, result_) \
+    LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readRange(filePath, offset, length, data, silent), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, void *data, const std::size_t length, std::size_t &readBytes, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readRange(filePath, offset, data, length, readBytes, silent), result_ ? readBytes : 0, result_) \
+    LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, std::string_view data) \
+        FS_TRACED(write, &filePath, posix::writeAt(filePath, offset, data), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, const std::vector<uint8_t> &data) \
+        FS_TRACED(write, &filePath, posix::writeAt(filePath, offset, data), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         readFileCompressed(const fs::path &filePath, fs::ReadBuffer &data, const unsigned threads) \
+        FS_TRACED(read, &filePath, posix::readFileCompressed(filePath, data, threads), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         readRangeCompressed(const fs::path &filePath, const uint64_t offset, const std::size_t length, fs::ReadBuffer &data) \
+        FS_TRACED(read, &filePath, posix::readRangeCompressed(filePath, offset, length, data), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options) \
+        FS_TRACED(write, &filePath, posix::writeFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options) \
+        FS_TRACED(write, &filePath, posix::writeFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, std::string_view data, const fs::compress_options &options) \
+        FS_TRACED(append, &filePath, posix::appendFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::compress_options &options) \
+        FS_TRACED(append, &filePath, posix::appendFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         removeDir(const fs::path &Path, const fs::remove_options &options) \
+        FS_TRACED(remove_dir, &Path, posix::removeDir(Path, options), 0, result_) \
+    LIB_EXPORT bool                         walk(const fs::path &Path, const fs::walk_visitor &visitor, const fs::walk_options &options) \
+        FS_TRACED(walk, &Path, posix::walk(Path, visitor, options), 0, result_) \
+    LIB_EXPORT const std::list<fs::path>    enumDir(const fs::path &Path, const fs::NameFilter &filter) \
+        FS_TRACED(enum_dir, &Path, posix::enumDir(Path, filter), 0, true) \
+    LIB_EXPORT bool                         copyFile(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options) \
+        FS_TRACED(copy, &fromPath, posix::copyFile(fromPath, toPath, options), 0, result_) \
+    LIB_EXPORT bool                         copyTree(const fs::path &fromPath, const fs::path &toPath, const fs::copy_options &options) \
+        FS_TRACED(copy, &fromPath, posix::copyTree(fromPath, toPath, options), 0, result_) \
+    LIB_EXPORT bool                         diffTrees(const fs::path &oldPath, const fs::path &newPath, std::vector<fs::tree_change> &changes, const fs::compare_options &options) \
+        FS_TRACED(compare, &newPath, posix::diffTrees(oldPath, newPath, changes, options), 0, result_) \
+    LIB_EXPORT bool                         findDuplicates(const fs::path &Path, std::vector<std::vector<fs::path>> &groups, const fs::compare_options &options) \
+        FS_TRACED(compare, &Path, posix::findDuplicates(Path, groups, options), 0, result_) \
+    LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, const std::vector<uint8_t> &data, const fs::atomic_write_options &options) \
+        FS_TRACED(atomic_write, &filePath, posix::writeFileAtomic(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::string_view data, const fs::atomic_write_options &options) \
+        FS_TRACED(atomic_write, &filePath, posix::writeFileAtomic(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::wstring_view data, const fs::atomic_write_options &options) \
+        FS_TRACED(atomic_write, &filePath, posix::writeFileAtomic(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFilesAtomic(const std::vector<fs::atomic_write> &files, const fs::atomic_write_options &options) \
+        FS_TRACED(atomic_write, nullptr, posix::writeFilesAtomic(files, options), result_ ? fs::internal::byteCount(files) : 0, result_) \
+    LIB_EXPORT bool                         getMetadata(const std::vector<fs::path> &paths, std::vector<fs::metadata> &results, const uint32_t fields, const unsigned threads) \
+        FS_TRACED(stat, nullptr, posix::getMetadata(paths, results, fields, threads), 0, result_) \
+    LIB_EXPORT std::vector<fs::io_result>   readFiles(const std::vector<fs::path> &paths, const fs::batch_options &options) \
+        FS_TRACED(batch_read, nullptr, posix::readFiles(paths, options), fs::internal::byteCount(result_), fs::internal::allSucceeded(result_)) \
+    LIB_EXPORT std::vector<fs::io_result>   writeFiles(const std::vector<fs::io_request> &requests, const fs::batch_options &options) \
+        FS_TRACED(batch_write, nullptr, posix::writeFiles(requests, options), fs::internal::byteCount(result_), fs::internal::allSucceeded(result_)) \
+    LIB_EXPORT bool                         createDirectories(const std::vector<fs::path> &paths, const fs::mkdir_options &options) \
+        FS_TRACED(create_directory, nullptr, posix::createDirectories(paths, options), 0, result_) \
+    LIB_EXPORT void                         setPathCache(const fs::path_cache_options &options) \
+        { posix::setPathCache(options); } \
+    LIB_EXPORT void                         invalidatePathCache(const fs::path &Path) \
+        { posix::invalidatePathCache(Path); } \
+    DEFINE_POSIX_EXT_BODY_FS_20()
+#if defined IS_CPP_20G
+#define DEFINE_POSIX_EXT_BODY_FS_20() \
+    LIB_EXPORT bool                         readFile(const fs::path &filePath, std::span<std::byte> data, std::size_t &readBytes, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readFile(filePath, data, readBytes, silent), result_ ? readBytes : 0, result_) \
+    LIB_EXPORT bool                         writeFile(const fs::path &filePath, std::span<const std::byte> data, fs::checksum &result, const bool force) \
+        FS_TRACED(write, &filePath, posix::writeFile(filePath, data, result, force), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         readRange(const fs::path &filePath, const uint64_t offset, std::span<std::byte> data, std::size_t &readBytes, const bool silent) \
+        FS_TRACED(read, &filePath, posix::readRange(filePath, offset, data, readBytes, silent), result_ ? readBytes : 0, result_) \
+    LIB_EXPORT bool                         writeAt(const fs::path &filePath, const uint64_t offset, std::span<const std::byte> data) \
+        FS_TRACED(write, &filePath, posix::writeAt(filePath, offset, data), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options) \
+        FS_TRACED(write, &filePath, posix::writeFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         appendFileCompressed(const fs::path &filePath, std::span<const std::byte> data, const fs::compress_options &options) \
+        FS_TRACED(append, &filePath, posix::appendFileCompressed(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_) \
+    LIB_EXPORT bool                         writeFileAtomic(const fs::path &filePath, std::span<const std::byte> data, const fs::atomic_write_options &options) \
+        FS_TRACED(atomic_write, &filePath, posix::writeFileAtomic(filePath, data, options), result_ ? fs::internal::byteCount(data) : 0, result_)
+#else
+#define DEFINE_POSIX_EXT_BODY_FS_20()
+#endif
+#else
+#define DEFINE_POSIX_EXT_BODY_FS()
+#endif
 
 namespace fs
 {
     DEFINE_BODY_FS()
+    DEFINE_POSIX_EXT_BODY_FS()
 }
\ No newline at end of file
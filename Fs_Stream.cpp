@@ -0,0 +1,430 @@
+#include "FsLib.h"
+#include "Fs_Instrument.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cstring>
+
+namespace fs
+{
+    FileReader::FileReader(FileReader &&other) noexcept
+        : m_handle(other.m_handle), m_options(other.m_options), m_buffer(std::move(other.m_buffer)),
+          m_hasher(other.m_hasher), m_offset(other.m_offset), m_size(other.m_size), m_dropped(other.m_dropped),
+          m_eof(other.m_eof), m_failed(other.m_failed), m_direct(other.m_direct)
+    {
+        other.m_handle = -1;
+    }
+
+    FileReader &FileReader::operator=(FileReader &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_handle        = other.m_handle;
+            m_options       = other.m_options;
+            m_buffer        = std::move(other.m_buffer);
+            m_hasher        = other.m_hasher;
+            m_offset        = other.m_offset;
+            m_size          = other.m_size;
+            m_dropped       = other.m_dropped;
+            m_eof           = other.m_eof;
+            m_failed        = other.m_failed;
+            m_direct        = other.m_direct;
+            other.m_handle  = -1;
+        }
+        return *this;
+    }
+
+    bool FileReader::open(const fs::path &filePath, const stream_options &options)
+    {
+        close();
+        m_options = options;
+        if (m_options.ChunkSize == 0)
+        {
+            m_options.ChunkSize = stream_options{}.ChunkSize;
+        }
+        m_hasher = Hasher(m_options.ChecksumAlgorithm);
+        m_direct = m_options.Direct;
+        m_handle = fs::internal::openDirect(filePath.c_str(), O_RDONLY | O_CLOEXEC, m_direct);
+        if (m_handle < 0)
+        {
+            return false;
+        }
+        struct stat stats;
+        if (fstat(m_handle, &stats) != 0 || S_ISDIR(stats.st_mode))
+        {
+            fs::internal::closeHandle(m_handle);
+            return false;
+        }
+        m_size = static_cast<uint64_t>(stats.st_size);
+        if (m_direct)
+        {
+            m_options.ChunkSize = static_cast<std::size_t>(fs::internal::alignUp(m_options.ChunkSize));
+            return true;
+        }
+        // Closest thing to O_DIRECT the filesystem allows
+        m_options.DropBehind |= m_options.Direct;
+        if (m_options.Sequential)
+        {
+            posix_fadvise(m_handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+        return true;
+    }
+
+    void FileReader::close()
+    {
+        fs::internal::closeHandle(m_handle);
+        m_offset  = 0;
+        m_size    = 0;
+        m_dropped = 0;
+        m_eof     = false;
+        m_failed  = false;
+        m_direct  = false;
+    }
+
+    bool FileReader::seek(const uint64_t offset)
+    {
+        if (m_handle < 0 || lseek(m_handle, static_cast<off_t>(offset), SEEK_SET) < 0)
+        {
+            return false;
+        }
+        m_offset  = offset;
+        m_dropped = offset;
+        m_eof     = false;
+        return true;
+    }
+
+    bool FileReader::readSome(void *data, const std::size_t size, std::size_t &readBytes)
+    {
+        FS_TRACED(read, nullptr, readInto(data, size, readBytes), result_ ? readBytes : 0, result_)
+    }
+
+    bool FileReader::nextChunk(std::string_view &chunk)
+    {
+        // Running into EOF isn't a failure
+        FS_TRACED(read, nullptr, readChunk(chunk), chunk.size(), result_ || m_eof)
+    }
+
+    bool FileReader::readInto(void *data, const std::size_t size, std::size_t &readBytes)
+    {
+        readBytes = 0;
+        if (m_handle < 0 || m_failed)
+        {
+            return false;
+        }
+        if (m_direct)
+        {
+            // Through the aligned buffer, a chunk at a time
+            auto *dst = static_cast<std::byte *>(data);
+            while (readBytes < size && !m_eof)
+            {
+                const std::byte *start = nullptr;
+                std::size_t chunk = 0;
+                if (!readDirect(std::min(size - readBytes, m_options.ChunkSize), start, chunk))
+                {
+                    return false;
+                }
+                std::memcpy(dst + readBytes, start, chunk);
+                readBytes += chunk;
+            }
+            m_eof = readBytes < size;
+            if (m_options.Checksum)
+            {
+                m_hasher.update(data, readBytes);
+            }
+            return true;
+        }
+        if (!fs::internal::readFull(m_handle, data, size, readBytes))
+        {
+            m_failed = true;
+            return false;
+        }
+        m_offset += readBytes;
+        m_eof     = readBytes < size;
+        if (m_options.Checksum)
+        {
+            m_hasher.update(data, readBytes);
+        }
+        if (m_options.DropBehind && m_offset - m_dropped >= m_options.ChunkSize)
+        {
+            // Pages already consumed are of no use to anyone, don't let them evict the working set
+            posix_fadvise(m_handle, static_cast<off_t>(m_dropped), static_cast<off_t>(m_offset - m_dropped), POSIX_FADV_DONTNEED);
+            m_dropped = m_offset;
+        }
+        return true;
+    }
+
+    bool FileReader::readChunk(std::string_view &chunk)
+    {
+        chunk = {};
+        if (m_eof)
+        {
+            return false;
+        }
+        std::size_t read_bytes = 0;
+        if (m_direct)
+        {
+            // Handed out straight from the aligned buffer
+            const std::byte *start = nullptr;
+            if (!readDirect(m_options.ChunkSize, start, read_bytes) || read_bytes == 0)
+            {
+                return false;
+            }
+            chunk = { reinterpret_cast<const char *>(start), read_bytes };
+            if (m_options.Checksum)
+            {
+                m_hasher.update(chunk);
+            }
+            return true;
+        }
+        m_buffer.resizeForOverwrite(m_options.ChunkSize);
+        if (!readInto(m_buffer.data(), m_buffer.size(), read_bytes) || read_bytes == 0)
+        {
+            m_buffer.clear();
+            return false;
+        }
+        m_buffer.resizeForOverwrite(read_bytes);
+        chunk = m_buffer.view();
+        return true;
+    }
+
+    // Reads [offset, offset + size) as whole aligned blocks, start points at offset inside the buffer
+    bool FileReader::readDirect(const std::size_t size, const std::byte *&start, std::size_t &readBytes)
+    {
+        const uint64_t    first     = fs::internal::alignDown(m_offset);
+        const std::size_t head      = static_cast<std::size_t>(m_offset - first);
+        const std::size_t length    = static_cast<std::size_t>(fs::internal::alignUp(head + size));
+        std::byte        *buffer    = fs::internal::alignedData(m_buffer, length);
+        std::size_t read_bytes = 0;
+        if (!fs::internal::preadDirect(m_handle, buffer, length, first, read_bytes))
+        {
+            m_failed = true;
+            return false;
+        }
+        start     = buffer + head;
+        readBytes = read_bytes > head ? std::min(read_bytes - head, size) : 0;
+        m_offset += readBytes;
+        m_eof     = readBytes < size;
+        return true;
+    }
+
+#if defined IS_CPP_20G
+    bool FileReader::nextChunk(std::span<const std::byte> &chunk)
+    {
+        std::string_view view;
+        const bool res = nextChunk(view);
+        chunk = { reinterpret_cast<const std::byte *>(view.data()), view.size() };
+        return res;
+    }
+#endif
+
+    FileWriter::FileWriter(FileWriter &&other) noexcept
+        : m_handle(other.m_handle), m_options(other.m_options), m_buffer(std::move(other.m_buffer)),
+          m_hasher(other.m_hasher), m_written(other.m_written), m_flushed(other.m_flushed), m_pending(other.m_pending),
+          m_failed(other.m_failed), m_direct(other.m_direct)
+    {
+        other.m_handle = -1;
+    }
+
+    FileWriter &FileWriter::operator=(FileWriter &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_handle        = other.m_handle;
+            m_options       = other.m_options;
+            m_buffer        = std::move(other.m_buffer);
+            m_hasher        = other.m_hasher;
+            m_written       = other.m_written;
+            m_flushed       = other.m_flushed;
+            m_pending       = other.m_pending;
+            m_failed        = other.m_failed;
+            m_direct        = other.m_direct;
+            other.m_handle  = -1;
+        }
+        return *this;
+    }
+
+    bool FileWriter::open(const fs::path &filePath, const bool append, const stream_options &options)
+    {
+        close();
+        m_options = options;
+        if (m_options.ChunkSize == 0)
+        {
+            m_options.ChunkSize = stream_options{}.ChunkSize;
+        }
+        m_hasher = Hasher(m_options.ChecksumAlgorithm);
+        // An appended file ends anywhere, O_DIRECT would need a read-modify-write of its last block
+        m_direct = m_options.Direct && !append;
+        m_handle = fs::internal::openDirect(filePath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), m_direct);
+        if (m_handle < 0)
+        {
+            return false;
+        }
+        if (m_direct)
+        {
+            m_options.ChunkSize = static_cast<std::size_t>(fs::internal::alignUp(m_options.ChunkSize));
+            fs::internal::alignedData(m_buffer, m_options.ChunkSize);
+            return true;
+        }
+        m_buffer.reserve(m_options.ChunkSize);
+        return true;
+    }
+
+    bool FileWriter::close()
+    {
+        if (m_handle < 0)
+        {
+            return false;
+        }
+        const bool res = flush();
+        fs::internal::closeHandle(m_handle);
+        m_buffer.clear();
+        m_written = 0;
+        m_flushed = 0;
+        m_pending = 0;
+        m_failed  = false;
+        m_direct  = false;
+        return res;
+    }
+
+    bool FileWriter::write(const void *data, const std::size_t size)
+    {
+        FS_TRACED(write, nullptr, put(data, size), result_ ? size : 0, result_)
+    }
+
+    bool FileWriter::flush()
+    {
+        FS_TRACED(sync, nullptr, flushBuffer(), 0, result_)
+    }
+
+    bool FileWriter::put(const void *data, const std::size_t size)
+    {
+        if (m_handle < 0 || m_failed)
+        {
+            return false;
+        }
+        if (m_direct)
+        {
+            // Everything goes through the aligned buffer, whole buffers go out as they fill
+            const auto *src = static_cast<const std::byte *>(data);
+            std::size_t done = 0;
+            while (done < size)
+            {
+                const std::size_t take = std::min(size - done, m_options.ChunkSize - m_pending);
+                std::memcpy(fs::internal::alignedData(m_buffer, m_options.ChunkSize) + m_pending, src + done, take);
+                m_pending += take;
+                done      += take;
+                if (m_pending == m_options.ChunkSize && !flushDirect())
+                {
+                    return false;
+                }
+            }
+            if (m_options.Checksum)
+            {
+                m_hasher.update(data, size);
+            }
+            m_written += size;
+            return true;
+        }
+        if (m_buffer.size() + size > m_options.ChunkSize && !flushBuffer())
+        {
+            return false;
+        }
+        // Big writes gain nothing from the copy, pass them straight through
+        if (size >= m_options.ChunkSize)
+        {
+            if (!fs::internal::writeFull(m_handle, data, size))
+            {
+                m_failed = true;
+                return false;
+            }
+        }
+        else
+        {
+            const std::size_t used = m_buffer.size();
+            m_buffer.resizeForOverwrite(used + size);
+            std::memcpy(m_buffer.data() + used, data, size);
+        }
+        if (m_options.Checksum)
+        {
+            m_hasher.update(data, size);
+        }
+        m_written += size;
+        return true;
+    }
+
+    bool FileWriter::flushBuffer()
+    {
+        if (m_handle < 0 || m_failed)
+        {
+            return false;
+        }
+        if (m_direct)
+        {
+            if (!flushDirect())
+            {
+                return false;
+            }
+            if (m_pending == 0)
+            {
+                return true;
+            }
+            // A partial block can't go direct. It goes through the page cache now and
+            // is written again, direct, once the block is complete.
+            const auto *buffer = fs::internal::alignedData(m_buffer, m_options.ChunkSize);
+            if (!fs::internal::setDirect(m_handle, false))
+            {
+                m_failed = true;
+                return false;
+            }
+            const bool res = fs::internal::pwriteFull(m_handle, buffer, m_pending, m_flushed);
+            if (!fs::internal::setDirect(m_handle, true) || !res)
+            {
+                m_failed = true;
+                return false;
+            }
+            return true;
+        }
+        if (m_buffer.empty())
+        {
+            return true;
+        }
+        if (!fs::internal::writeFull(m_handle, m_buffer.data(), m_buffer.size()))
+        {
+            m_failed = true;
+            return false;
+        }
+        m_buffer.clear();
+        return true;
+    }
+
+    // Whole blocks of the aligned buffer go out, the tail moves to its front
+    bool FileWriter::flushDirect()
+    {
+        auto *buffer = fs::internal::alignedData(m_buffer, m_options.ChunkSize);
+        const std::size_t blocks = static_cast<std::size_t>(fs::internal::alignDown(m_pending));
+        if (blocks == 0)
+        {
+            return true;
+        }
+        if (!fs::internal::pwriteFull(m_handle, buffer, blocks, m_flushed))
+        {
+            m_failed = true;
+            return false;
+        }
+        m_flushed += blocks;
+        m_pending -= blocks;
+        std::memmove(buffer, buffer + blocks, m_pending);
+        return true;
+    }
+
+    bool FileWriter::sync(const bool dataOnly)
+    {
+        FS_TRACED(sync, nullptr, flushBuffer() && (dataOnly ? fdatasync(m_handle) : fsync(m_handle)) == 0, 0, result_)
+    }
+}
+#endif
@@ -0,0 +1,171 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+namespace
+{
+    // Layout of the records getdents64 fills the buffer with
+    struct linux_dirent64
+    {
+        uint64_t        d_ino;
+        int64_t         d_off;
+        unsigned short  d_reclen;
+        unsigned char   d_type;
+        char            d_name[1];
+    };
+
+    fs::entry_type direntType(const unsigned char type)
+    {
+        switch (type)
+        {
+        case DT_REG:        return fs::entry_type::file;
+        case DT_DIR:        return fs::entry_type::directory;
+        case DT_LNK:        return fs::entry_type::symlink;
+        case DT_UNKNOWN:    return fs::entry_type::unknown;
+        default:            return fs::entry_type::other;
+        }
+    }
+
+    struct WalkLevel
+    {
+        int         Handle      = -1;
+        std::size_t Used        = 0;
+        std::size_t Position    = 0;
+        std::size_t PrefixSize  = 0;    // size of the relative prefix before this level was entered
+    };
+}
+
+namespace fs
+{
+    fs::path walk_entry::path() const
+    {
+        return Parent.empty() ? fs::path(Name) : fs::path(Parent) / Name;
+    }
+
+    const struct stat *walk_entry::stat() const
+    {
+        if (m_statState == 0)
+        {
+            // Name points into the getdents buffer and is null terminated there
+            m_statState = fstatat(DirHandle, Name.data(), &m_stat, AT_SYMLINK_NOFOLLOW) == 0 ? 1 : -1;
+        }
+        return m_statState > 0 ? &m_stat : nullptr;
+    }
+}
+
+namespace fs::posix
+{
+    LIB_EXPORT
+    bool walk(const fs::path &Path, const fs::walk_visitor &visitor, const fs::walk_options &options)
+    {
+        const std::size_t buffer_size = std::max<std::size_t>(options.BufferSize, 4096);
+        const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+        std::vector<WalkLevel> levels;
+        // One getdents buffer per depth, kept while walking siblings at that depth
+        std::vector<std::unique_ptr<char[]>> buffers;
+        std::string prefix;
+        bool result = true;
+        MakeScopeGuard([&] { for (auto &it : levels) { fs::internal::closeHandle(it.Handle); } });
+
+        WalkLevel root;
+        root.Handle = open(Path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root.Handle < 0)
+        {
+            return false;
+        }
+        levels.push_back(root);
+        while (!levels.empty())
+        {
+            WalkLevel &level = levels.back();
+            const std::size_t depth = levels.size();
+            if (buffers.size() < depth)
+            {
+                buffers.emplace_back(new char[buffer_size]);
+            }
+            char *buffer = buffers[depth - 1].get();
+            if (level.Position >= level.Used)
+            {
+                const long res = syscall(SYS_getdents64, level.Handle, buffer, buffer_size);
+                if (res < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (res <= 0)
+                {
+                    if (res < 0)
+                    {
+                        result = false;
+                        if (options.StopOnError)
+                        {
+                            break;
+                        }
+                    }
+                    prefix.resize(level.PrefixSize);
+                    fs::internal::closeHandle(level.Handle);
+                    levels.pop_back();
+                    continue;
+                }
+                level.Used     = static_cast<std::size_t>(res);
+                level.Position = 0;
+            }
+            const auto *record = reinterpret_cast<const linux_dirent64 *>(buffer + level.Position);
+            level.Position += record->d_reclen;
+            const char *name = record->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+            {
+                continue;
+            }
+
+            fs::walk_entry entry;
+            entry.Name      = name;
+            entry.Parent    = prefix;
+            entry.Type      = direntType(record->d_type);
+            entry.Depth     = static_cast<unsigned>(depth);
+            entry.Inode     = record->d_ino;
+            entry.DirHandle = level.Handle;
+            if (entry.Type == fs::entry_type::unknown)
+            {
+                // Filesystem doesn't fill d_type, a stat is unavoidable
+                const struct stat *stats = entry.stat();
+                entry.Type = stats ? fs::internal::modeType(stats->st_mode) : fs::entry_type::unknown;
+            }
+
+            const bool visible = options.Filter.matchesAll() || options.Filter.match(entry.Name);
+            const auto action  = visible ? visitor(entry) : fs::walk_action::next;
+            if (action == fs::walk_action::stop)
+            {
+                break;
+            }
+            if (entry.Type != fs::entry_type::directory || action == fs::walk_action::skip ||
+               (options.MaxDepth != 0 && depth >= options.MaxDepth))
+            {
+                continue;
+            }
+            WalkLevel next;
+            next.Handle = openat(level.Handle, name, flags);
+            if (next.Handle < 0)
+            {
+                result = false;
+                if (options.StopOnError)
+                {
+                    break;
+                }
+                continue;
+            }
+            next.PrefixSize = prefix.size();
+            if (!prefix.empty())
+            {
+                prefix += '/';
+            }
+            prefix += name;
+            // Invalidates `level`, nothing below touches it
+            levels.push_back(next);
+        }
+        return result;
+    }
+}
+#endif
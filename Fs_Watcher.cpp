@@ -0,0 +1,813 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#include <unordered_map>
+
+namespace
+{
+    constexpr uint32_t watch_events = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+                                      IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+    using clock = std::chrono::steady_clock;
+
+    // path is directory or below it
+    bool under(const std::string &path, const std::string &directory)
+    {
+        return path.size() >= directory.size() && path.compare(0, directory.size(), directory) == 0 &&
+               (path.size() == directory.size() || path[directory.size()] == '/' || directory == "/");
+    }
+
+    std::string join(const std::string &directory, std::string_view name)
+    {
+        std::string result = directory;
+        if (result != "/")
+        {
+            result += '/';
+        }
+        return result.append(name.data(), name.size());
+    }
+
+    std::string normalized(const fs::path &Path)
+    {
+        std::error_code err;
+        std::string result = std::filesystem::absolute(Path, err).lexically_normal().native();
+        while (result.size() > 1 && result.back() == '/')
+        {
+            result.pop_back();
+        }
+        return result;
+    }
+
+    // What a poll compares between two listings of a directory
+    struct Snapshot
+    {
+        fs::entry_type  Type    = fs::entry_type::unknown;
+        uint64_t        Size    = 0;
+        int64_t         Mtime   = 0;
+    };
+
+    using listing = std::unordered_map<std::string, Snapshot>;     // by name
+
+    bool listDirectory(const std::string &directory, listing &entries)
+    {
+        fs::walk_options walk_options;
+        walk_options.MaxDepth = 1;
+        entries.clear();
+        return fs::posix::walk(directory, [&](const fs::walk_entry &entry)
+        {
+            Snapshot snapshot;
+            snapshot.Type = entry.Type;
+            if (const struct stat *stats = entry.stat())
+            {
+                snapshot.Size  = static_cast<uint64_t>(stats->st_size);
+                snapshot.Mtime = stats->st_mtim.tv_sec * 1000000000LL + stats->st_mtim.tv_nsec;
+            }
+            entries.emplace(std::string(entry.Name), snapshot);
+            return fs::walk_action::next;
+        }, walk_options);
+    }
+
+    fs::entry_type eventKind(const fs::entry_type type)
+    {
+        return type == fs::entry_type::directory ? fs::entry_type::directory : fs::entry_type::file;
+    }
+}
+
+namespace fs
+{
+    struct Watcher::Impl
+    {
+        struct WatchedDir
+        {
+            std::string Path;
+            bool        Recursive   = true;
+        };
+
+        struct PolledDir
+        {
+            bool        Recursive   = true;
+            listing     Entries;
+        };
+
+        struct Pending
+        {
+            fs::watch_event Event;
+            bool            Live    = true;     // false once coalesced away
+        };
+
+        struct MovedFrom
+        {
+            std::string     Path;
+            fs::entry_type  Kind    = fs::entry_type::file;
+        };
+
+        explicit Impl(const watcher_options &options);
+        ~Impl();
+
+        void wake() const;
+        // Under Lock
+        bool watchOne(const std::string &directory, const bool recursive);
+        bool watch(const std::string &directory, const bool recursive, const bool report);
+        void unwatch(const std::string &directory);
+        void rename(const std::string &from, const std::string &to);
+        bool isRoot(const std::string &directory) const;
+        bool reported(std::string_view name) const;
+        void push(const fs::watch_event_type type, const fs::entry_type kind, const std::string &path, const std::string &from = {});
+        void handleEvent(const inotify_event &event);
+        void pollDirectories();
+        std::vector<fs::watch_event> batch();
+        void run();
+
+        watcher_options                             Options;
+        mutable std::mutex                          Lock;
+        std::condition_variable                     Ready;
+        std::unordered_map<int, WatchedDir>         Watches;
+        std::unordered_map<std::string, int>        WatchByPath;
+        std::unordered_map<std::string, PolledDir>  Polled;
+        std::vector<std::pair<std::string, bool>>   Roots;      // path, recursive
+        std::vector<Pending>                        Batch;
+        std::unordered_map<std::string, std::size_t> BatchIndex;   // path -> its latest event in Batch
+        std::unordered_map<uint32_t, MovedFrom>     Moves;      // IN_MOVED_FROM waiting for its IN_MOVED_TO, by cookie
+        bool                                        Collecting  = false;
+        clock::time_point                           BatchStart;
+        clock::time_point                           NextPoll;
+        std::deque<fs::watch_event>                 Queue;      // batches waiting for take()
+        bool                                        Stop        = false;
+        std::atomic<bool>                           Failed      { false };  // the watcher thread is gone, no more events
+        int                                         Inotify     = -1;
+        int                                         WakeEvent   = -1;
+        int                                         ReadyEvent  = -1;
+        std::thread                                 Thread;
+    };
+
+    Watcher::Impl::Impl(const watcher_options &options)
+        : Options(options)
+    {
+        Inotify     = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        WakeEvent   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ReadyEvent  = Options.Callback ? -1 : eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (Inotify < 0 || WakeEvent < 0 || (!Options.Callback && ReadyEvent < 0))
+        {
+            fs::internal::closeHandle(Inotify);
+            fs::internal::closeHandle(WakeEvent);
+            fs::internal::closeHandle(ReadyEvent);
+            return;
+        }
+        Thread = std::thread([this] { run(); });
+    }
+
+    Watcher::Impl::~Impl()
+    {
+        if (Thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                Stop = true;
+            }
+            wake();
+            Thread.join();
+        }
+        fs::internal::closeHandle(Inotify);
+        fs::internal::closeHandle(WakeEvent);
+        fs::internal::closeHandle(ReadyEvent);
+    }
+
+    void Watcher::Impl::wake() const
+    {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto res = write(WakeEvent, &one, sizeof(one));
+    }
+
+    bool Watcher::Impl::watchOne(const std::string &directory, const bool recursive)
+    {
+        const int watch_handle = inotify_add_watch(Inotify, directory.c_str(), watch_events);
+        if (watch_handle >= 0)
+        {
+            // Same directory under another path (bind mounts) or added again, as a nested
+            // root for instance, gets the same descriptor; a recursive watch stays recursive
+            bool was_recursive = false;
+            const auto old = Watches.find(watch_handle);
+            if (old != Watches.end())
+            {
+                was_recursive = old->second.Recursive;
+                WatchByPath.erase(old->second.Path);
+            }
+            Watches[watch_handle] = { directory, recursive || was_recursive };
+            WatchByPath[directory] = watch_handle;
+            Polled.erase(directory);
+            return true;
+        }
+        if (errno != ENOSPC && errno != ENOMEM)
+        {
+            return false;
+        }
+        // Out of watches, the directory is listed every RescanInterval instead
+        if (Polled.empty())
+        {
+            NextPoll = clock::now() + Options.RescanInterval;
+        }
+        const bool was_polled = Polled.count(directory) != 0;
+        auto &polled = Polled[directory];
+        polled.Recursive = recursive || (was_polled && polled.Recursive);
+        return listDirectory(directory, polled.Entries);
+    }
+
+    // Watch first, list second: whatever appears in between shows up as an
+    // event, possibly on top of the created one report gives
+    bool Watcher::Impl::watch(const std::string &directory, const bool recursive, const bool report)
+    {
+        if (!watchOne(directory, recursive))
+        {
+            return false;
+        }
+        if (!recursive && !report)
+        {
+            return true;
+        }
+        fs::walk_options walk_options;
+        walk_options.MaxDepth = recursive ? 0 : 1;
+        fs::posix::walk(directory, [&](const fs::walk_entry &entry)
+        {
+            const auto path = join(directory, entry.path().native());
+            const auto kind = eventKind(entry.Type);
+            if (kind == fs::entry_type::directory && recursive)
+            {
+                watchOne(path, true);
+            }
+            if (report && (kind == fs::entry_type::directory || reported(entry.Name)))
+            {
+                push(fs::watch_event_type::created, kind, path);
+            }
+            return fs::walk_action::next;
+        }, walk_options);
+        return true;
+    }
+
+    void Watcher::Impl::unwatch(const std::string &directory)
+    {
+        for (auto it = Watches.begin(); it != Watches.end();)
+        {
+            if (under(it->second.Path, directory))
+            {
+                // IN_IGNORED for it then finds nothing
+                inotify_rm_watch(Inotify, it->first);
+                WatchByPath.erase(it->second.Path);
+                it = Watches.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (auto it = Polled.begin(); it != Polled.end();)
+        {
+            it = under(it->first, directory) ? Polled.erase(it) : std::next(it);
+        }
+    }
+
+    // A watched directory moved within the watched trees keeps its watches under the new name
+    void Watcher::Impl::rename(const std::string &from, const std::string &to)
+    {
+        for (auto &it : Watches)
+        {
+            if (under(it.second.Path, from))
+            {
+                WatchByPath.erase(it.second.Path);
+                it.second.Path = to + it.second.Path.substr(from.size());
+                WatchByPath[it.second.Path] = it.first;
+            }
+        }
+        std::vector<std::pair<std::string, PolledDir>> moved;
+        for (auto it = Polled.begin(); it != Polled.end();)
+        {
+            if (under(it->first, from))
+            {
+                moved.emplace_back(to + it->first.substr(from.size()), std::move(it->second));
+                it = Polled.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (auto &it : moved)
+        {
+            Polled[it.first] = std::move(it.second);
+        }
+    }
+
+    bool Watcher::Impl::isRoot(const std::string &directory) const
+    {
+        return std::any_of(Roots.begin(), Roots.end(), [&](const auto &root) { return root.first == directory; });
+    }
+
+    bool Watcher::Impl::reported(std::string_view name) const
+    {
+        return Options.Filter.matchesAll() || Options.Filter.match(name);
+    }
+
+    void Watcher::Impl::push(const fs::watch_event_type type, const fs::entry_type kind, const std::string &path, const std::string &from)
+    {
+        using event_type = fs::watch_event_type;
+        if (!Collecting)
+        {
+            Collecting = true;
+            BatchStart = clock::now();
+        }
+        if (type == event_type::moved || type == event_type::rescan)
+        {
+            // Nothing merges across these
+            BatchIndex.erase(path);
+            BatchIndex.erase(from);
+        }
+        else
+        {
+            const auto it = BatchIndex.find(path);
+            if (it != BatchIndex.end() && Batch[it->second].Live && Batch[it->second].Event.Kind == kind)
+            {
+                auto &previous = Batch[it->second].Event;
+                if (previous.Type == type || (previous.Type == event_type::created && type == event_type::modified))
+                {
+                    return;
+                }
+                if (previous.Type == event_type::created && type == event_type::removed)
+                {
+                    Batch[it->second].Live = false;
+                    BatchIndex.erase(it);
+                    return;
+                }
+                if (previous.Type == event_type::modified && type == event_type::removed)
+                {
+                    previous.Type = event_type::removed;
+                    return;
+                }
+                if (previous.Type == event_type::removed && type == event_type::created && kind == fs::entry_type::file)
+                {
+                    previous.Type = event_type::modified;
+                    return;
+                }
+            }
+            BatchIndex[path] = Batch.size();
+        }
+        Pending pending;
+        pending.Event.Type  = type;
+        pending.Event.Kind  = kind;
+        pending.Event.Path  = path;
+        pending.Event.From  = from;
+        Batch.push_back(std::move(pending));
+    }
+
+    void Watcher::Impl::handleEvent(const inotify_event &event)
+    {
+        using event_type = fs::watch_event_type;
+        if (event.mask & IN_Q_OVERFLOW)
+        {
+            // Events were lost anywhere: every root is to be looked at again, and
+            // directories created in the gap have no watch yet
+            for (const auto &[root, recursive] : std::vector<std::pair<std::string, bool>>(Roots))
+            {
+                push(event_type::rescan, fs::entry_type::directory, root);
+                watch(root, recursive, false);
+            }
+            return;
+        }
+        const auto dir = Watches.find(event.wd);
+        if (dir == Watches.end())
+        {
+            return;
+        }
+        if (event.mask & IN_IGNORED)
+        {
+            WatchByPath.erase(dir->second.Path);
+            Watches.erase(dir);
+            return;
+        }
+        const std::string directory = dir->second.Path;
+        const bool recursive = dir->second.Recursive;
+        if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT))
+        {
+            // Anything below a root is reported by its parent
+            if (isRoot(directory))
+            {
+                push(event_type::removed, fs::entry_type::directory, directory);
+                unwatch(directory);
+                Roots.erase(std::remove_if(Roots.begin(), Roots.end(), [&](const auto &root) { return root.first == directory; }), Roots.end());
+            }
+            return;
+        }
+        if (event.len == 0)
+        {
+            return;
+        }
+        const std::string_view name = event.name;
+        const std::string path = join(directory, name);
+        const auto kind = event.mask & IN_ISDIR ? fs::entry_type::directory : fs::entry_type::file;
+        if (kind != fs::entry_type::directory && !reported(name))
+        {
+            return;
+        }
+        if (event.mask & IN_CREATE)
+        {
+            push(event_type::created, kind, path);
+            if (kind == fs::entry_type::directory && recursive)
+            {
+                watch(path, true, true);
+            }
+        }
+        else if (event.mask & IN_DELETE)
+        {
+            push(event_type::removed, kind, path);
+        }
+        else if (event.mask & (IN_MODIFY | IN_CLOSE_WRITE))
+        {
+            if (kind == fs::entry_type::file)
+            {
+                push(event_type::modified, kind, path);
+            }
+        }
+        else if (event.mask & IN_MOVED_FROM)
+        {
+            Moves[event.cookie] = { path, kind };
+            if (!Collecting)
+            {
+                Collecting = true;
+                BatchStart = clock::now();
+            }
+        }
+        else if (event.mask & IN_MOVED_TO)
+        {
+            const auto from = Moves.find(event.cookie);
+            if (from == Moves.end())
+            {
+                push(event_type::created, kind, path);
+                if (kind == fs::entry_type::directory && recursive)
+                {
+                    watch(path, true, true);
+                }
+                return;
+            }
+            push(event_type::moved, kind, path, from->second.Path);
+            if (kind == fs::entry_type::directory)
+            {
+                rename(from->second.Path, path);
+                if (!recursive)
+                {
+                    unwatch(path);
+                }
+            }
+            Moves.erase(from);
+        }
+    }
+
+    void Watcher::Impl::pollDirectories()
+    {
+        using event_type = fs::watch_event_type;
+        std::vector<std::string> directories;
+        for (const auto &it : Polled)
+        {
+            directories.push_back(it.first);
+        }
+        for (const auto &directory : directories)
+        {
+            auto it = Polled.find(directory);
+            if (it == Polled.end())
+            {
+                continue;
+            }
+            const bool recursive = it->second.Recursive;
+            // The limit may have been raised or watches freed, try again before listing
+            const int watch_handle = inotify_add_watch(Inotify, directory.c_str(), watch_events);
+            listing now;
+            if (!listDirectory(directory, now))
+            {
+                // Gone, its parent reports that
+                if (watch_handle >= 0)
+                {
+                    inotify_rm_watch(Inotify, watch_handle);
+                }
+                Polled.erase(it);
+                continue;
+            }
+            const listing before = std::move(it->second.Entries);
+            for (const auto &[name, snapshot] : now)
+            {
+                const auto kind = eventKind(snapshot.Type);
+                const auto path = join(directory, name);
+                const auto old = before.find(name);
+                const bool visible = kind == fs::entry_type::directory || reported(name);
+                if (old == before.end() || eventKind(old->second.Type) != kind)
+                {
+                    if (old != before.end() && (eventKind(old->second.Type) == fs::entry_type::directory || reported(name)))
+                    {
+                        push(event_type::removed, eventKind(old->second.Type), path);
+                        unwatch(path);
+                    }
+                    if (visible)
+                    {
+                        push(event_type::created, kind, path);
+                    }
+                    if (kind == fs::entry_type::directory && recursive)
+                    {
+                        watch(path, true, true);
+                    }
+                }
+                else if (kind == fs::entry_type::file && visible &&
+                         (old->second.Size != snapshot.Size || old->second.Mtime != snapshot.Mtime))
+                {
+                    push(event_type::modified, kind, path);
+                }
+            }
+            for (const auto &[name, snapshot] : before)
+            {
+                if (now.find(name) != now.end())
+                {
+                    continue;
+                }
+                const auto kind = eventKind(snapshot.Type);
+                const auto path = join(directory, name);
+                if (kind == fs::entry_type::directory || reported(name))
+                {
+                    push(event_type::removed, kind, path);
+                }
+                if (kind == fs::entry_type::directory)
+                {
+                    unwatch(path);
+                }
+            }
+            if (watch_handle >= 0)
+            {
+                Polled.erase(directory);
+                Watches[watch_handle] = { directory, recursive };
+                WatchByPath[directory] = watch_handle;
+                continue;
+            }
+            // watch() above may have added entries and invalidated it
+            Polled[directory].Entries = std::move(now);
+        }
+    }
+
+    // The batch so far, moves still missing their other half become removals
+    std::vector<fs::watch_event> Watcher::Impl::batch()
+    {
+        for (const auto &[cookie, from] : std::unordered_map<uint32_t, MovedFrom>(std::move(Moves)))
+        {
+            push(fs::watch_event_type::removed, from.Kind, from.Path);
+            if (from.Kind == fs::entry_type::directory)
+            {
+                unwatch(from.Path);
+            }
+        }
+        Moves.clear();
+        std::vector<fs::watch_event> result;
+        for (auto &pending : Batch)
+        {
+            if (pending.Live)
+            {
+                result.push_back(std::move(pending.Event));
+            }
+        }
+        Batch.clear();
+        BatchIndex.clear();
+        Collecting = false;
+        return result;
+    }
+
+    void Watcher::Impl::run()
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        pollfd handles[2] = { { Inotify, POLLIN, 0 }, { WakeEvent, POLLIN, 0 } };
+        while (true)
+        {
+            int timeout = -1;
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                if (Stop)
+                {
+                    break;
+                }
+                auto next = clock::time_point::max();
+                if (Collecting)
+                {
+                    next = BatchStart + Options.Latency;
+                }
+                if (!Polled.empty())
+                {
+                    next = std::min(next, NextPoll);
+                }
+                if (next != clock::time_point::max())
+                {
+                    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - clock::now()).count();
+                    timeout = static_cast<int>(std::clamp<int64_t>(wait, 0, 24 * 3600 * 1000));
+                }
+            }
+            if (poll(handles, 2, timeout) < 0 && errno != EINTR)
+            {
+                if (errno == ENOMEM || errno == EAGAIN)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                // Nothing more is going to be reported, let waiters and operator bool know
+                std::lock_guard<std::mutex> guard(Lock);
+                Failed = true;
+                if (ReadyEvent >= 0)
+                {
+                    const uint64_t one = 1;
+                    [[maybe_unused]] const auto res = write(ReadyEvent, &one, sizeof(one));
+                }
+                Ready.notify_all();
+                break;
+            }
+            if (handles[1].revents & POLLIN)
+            {
+                uint64_t value = 0;
+                [[maybe_unused]] const auto res = ::read(WakeEvent, &value, sizeof(value));
+            }
+
+            std::vector<fs::watch_event> ready;
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                if (Stop)
+                {
+                    break;
+                }
+                if (handles[0].revents & POLLIN)
+                {
+                    ssize_t length = 0;
+                    while ((length = ::read(Inotify, buffer, sizeof(buffer))) > 0)
+                    {
+                        for (ssize_t pos = 0; pos < length;)
+                        {
+                            const auto *event = reinterpret_cast<const inotify_event *>(buffer + pos);
+                            pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                            handleEvent(*event);
+                        }
+                    }
+                }
+                const auto now = clock::now();
+                if (!Polled.empty() && now >= NextPoll)
+                {
+                    pollDirectories();
+                    NextPoll = now + Options.RescanInterval;
+                }
+                if (Collecting && now >= BatchStart + Options.Latency)
+                {
+                    ready = batch();
+                }
+                if (!ready.empty() && !Options.Callback)
+                {
+                    Queue.insert(Queue.end(), std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.end()));
+                    ready.clear();
+                    const uint64_t one = 1;
+                    [[maybe_unused]] const auto res = write(ReadyEvent, &one, sizeof(one));
+                    Ready.notify_all();
+                }
+            }
+            if (!ready.empty())
+            {
+                Options.Callback(std::move(ready));
+            }
+        }
+    }
+
+    Watcher::Watcher(const watcher_options &options)
+        : m_impl(std::make_unique<Impl>(options))
+    {
+    }
+
+    Watcher::Watcher(Watcher &&other) noexcept = default;
+
+    Watcher &Watcher::operator=(Watcher &&other) noexcept = default;
+
+    Watcher::~Watcher() = default;
+
+    Watcher::operator bool() const
+    {
+        return m_impl && m_impl->Thread.joinable() && !m_impl->Failed;
+    }
+
+    bool Watcher::add(const fs::path &Path, const bool recursive)
+    {
+        if (!*this)
+        {
+            return false;
+        }
+        const std::string directory = normalized(Path);
+        struct stat stats;
+        if (stat(directory.c_str(), &stats) != 0 || !S_ISDIR(stats.st_mode))
+        {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> guard(m_impl->Lock);
+            if (!m_impl->watch(directory, recursive, false))
+            {
+                return false;
+            }
+            if (!m_impl->isRoot(directory))
+            {
+                m_impl->Roots.emplace_back(directory, recursive);
+            }
+        }
+        // Polled directories change the watcher thread's timeout
+        m_impl->wake();
+        return true;
+    }
+
+    bool Watcher::remove(const fs::path &Path)
+    {
+        if (!*this)
+        {
+            return false;
+        }
+        const std::string directory = normalized(Path);
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        auto &roots = m_impl->Roots;
+        const auto it = std::find_if(roots.begin(), roots.end(), [&](const auto &root) { return root.first == directory; });
+        if (it == roots.end())
+        {
+            return false;
+        }
+        roots.erase(it);
+        // A recursive root around it still needs every watch below
+        if (std::any_of(roots.begin(), roots.end(), [&](const auto &root) { return root.second && under(directory, root.first); }))
+        {
+            return true;
+        }
+        m_impl->unwatch(directory);
+        // Roots nested in the removed one keep watching
+        for (const auto &[root, recursive] : std::vector<std::pair<std::string, bool>>(roots))
+        {
+            if (under(root, directory))
+            {
+                m_impl->watch(root, recursive, false);
+            }
+        }
+        return true;
+    }
+
+    std::size_t Watcher::watchCount() const
+    {
+        if (!m_impl)
+        {
+            return 0;
+        }
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        return m_impl->Watches.size();
+    }
+
+    std::size_t Watcher::polledCount() const
+    {
+        if (!m_impl)
+        {
+            return 0;
+        }
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        return m_impl->Polled.size();
+    }
+
+    int Watcher::handle() const
+    {
+        return m_impl ? m_impl->ReadyEvent : -1;
+    }
+
+    bool Watcher::take(std::vector<fs::watch_event> &events)
+    {
+        events.clear();
+        if (!m_impl || m_impl->ReadyEvent < 0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(m_impl->Lock);
+        uint64_t value = 0;
+        [[maybe_unused]] const auto res = ::read(m_impl->ReadyEvent, &value, sizeof(value));
+        events.assign(std::make_move_iterator(m_impl->Queue.begin()), std::make_move_iterator(m_impl->Queue.end()));
+        m_impl->Queue.clear();
+        return !events.empty();
+    }
+
+    bool Watcher::wait(std::vector<fs::watch_event> &events, const std::chrono::milliseconds timeout)
+    {
+        events.clear();
+        if (!m_impl || m_impl->ReadyEvent < 0)
+        {
+            return false;
+        }
+        {
+            std::unique_lock<std::mutex> guard(m_impl->Lock);
+            if (!m_impl->Ready.wait_for(guard, timeout, [&] { return !m_impl->Queue.empty() || m_impl->Failed; }) ||
+                m_impl->Queue.empty())
+            {
+                return false;
+            }
+        }
+        return take(events);
+    }
+}
+#endif
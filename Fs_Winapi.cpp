@@ -10,13 +10,54 @@
 
 namespace
 {
+    // ReadFile / WriteFile take a DWORD length, files past 4 GB go in pieces
+    constexpr DWORD io_chunk_size = 1u << 30;
+
+    bool writeAll(const HANDLE handle, const void *data, const uint64_t size)
+    {
+        const auto *src     = static_cast<const uint8_t *>(data);
+        uint64_t    written = 0;
+        while (written < size)
+        {
+            const DWORD chunk   = static_cast<DWORD>(std::min<uint64_t>(size - written, io_chunk_size));
+            DWORD       done    = 0;
+            if (!WriteFile(handle, src + written, chunk, &done, nullptr) || done == 0)
+            {
+                return false;
+            }
+            written += done;
+        }
+        return true;
+    }
+
+    // Stops early on EOF, readBytes tells how much arrived
+    bool readAll(const HANDLE handle, void *data, const uint64_t size, uint64_t &readBytes)
+    {
+        auto *dst = static_cast<uint8_t *>(data);
+        readBytes = 0;
+        while (readBytes < size)
+        {
+            const DWORD chunk   = static_cast<DWORD>(std::min<uint64_t>(size - readBytes, io_chunk_size));
+            DWORD       done    = 0;
+            if (!ReadFile(handle, dst + readBytes, chunk, &done, nullptr))
+            {
+                return false;
+            }
+            if (done == 0)
+            {
+                break;
+            }
+            readBytes += done;
+        }
+        return true;
+    }
+
     template<typename T>
     bool writeFileEx(const fs::path &filePath, const T &data, const bool force)
     {
         const auto  last_error      = GetLastError();
         const auto  expanded_path   = fs::expandPath(filePath);
-        DWORD       dw_written      = 0,
-                    attributes      = force ? CREATE_ALWAYS : CREATE_NEW;
+        const DWORD attributes      = force ? CREATE_ALWAYS : CREATE_NEW;
         MakeScopeGuard([&] { SetLastError(last_error); });
         auto h_File = CreateFileW(expanded_path.c_str(), GENERIC_WRITE, 0, nullptr, attributes, FILE_ATTRIBUTE_NORMAL, nullptr);
         if (!h_File || h_File == INVALID_HANDLE_VALUE)
@@ -24,12 +65,7 @@ namespace
             return false;
         }
         MakeScopeGuard([&] { if (h_File && h_File != INVALID_HANDLE_VALUE) { CloseHandle(h_File); h_File = nullptr; }});
-        const size_t size_bytes = data.size() / sizeof(T::value_type);
-        if (!WriteFile(h_File, data.data(), static_cast<DWORD>(size_bytes), &dw_written, nullptr) || dw_written != size_bytes)
-        {
-            return false;
-        }
-        return true;
+        return writeAll(h_File, data.data(), static_cast<uint64_t>(data.size()) * sizeof(T::value_type));
     }
 
     template<typename T>
@@ -38,7 +74,6 @@ namespace
         const auto              last_error = GetLastError();
         const auto              expanded_path = fs::expandPath(filePath);
         fs::file_metadata file_attributes;
-        DWORD             dw_read = 0;
         LARGE_INTEGER     li_size = {};
         ZeroMemory(&file_attributes, sizeof(fs::file_metadata));
         MakeScopeGuard([&] { SetLastError(last_error); });
@@ -56,12 +91,14 @@ namespace
         {
             return false;
         }
-        data.resize(li_size.QuadPart / sizeof(T::value_type));
-        if (!ReadFile(h_File, data.data(), static_cast<DWORD>(li_size.QuadPart), &dw_read, nullptr))
+        data.resize(static_cast<std::size_t>(li_size.QuadPart) / sizeof(T::value_type));
+        uint64_t read_bytes = 0;
+        if (!readAll(h_File, data.data(), static_cast<uint64_t>(data.size()) * sizeof(T::value_type), read_bytes))
         {
             data.resize(0);
             return false;
         }
+        data.resize(static_cast<std::size_t>(read_bytes / sizeof(T::value_type)));
         if (silent && !fs::winapi::setFileMetadata(filePath, file_attributes))
         {
             data.resize(0);
@@ -76,7 +113,6 @@ namespace
         const auto              last_error      = GetLastError();
         const auto              expanded_path   = fs::expandPath(filePath);
         fs::file_metadata file_attributes;
-        DWORD             dw_written = 0;
 
         ZeroMemory(&file_attributes, sizeof(fs::file_metadata));
         MakeScopeGuard([&] { SetLastError(last_error); });
@@ -95,8 +131,7 @@ namespace
         {
             return false;
         }
-        const size_t size_bytes = data.size() / sizeof(T::value_type);
-        if (!WriteFile(h_File, data.data(), static_cast<DWORD>(size_bytes), &dw_written, nullptr) || dw_written == 0)
+        if (!writeAll(h_File, data.data(), static_cast<uint64_t>(data.size()) * sizeof(T::value_type)))
         {
             return false;
         }
@@ -301,6 +336,7 @@ const std::list<fs::path> enumDir(const fs::path &Path, const std::string& regFi
           WIN32_FIND_DATAW      file_info;
           std::list<fs::path>   result;
     const auto                  utf_filter   = ConvertUTF::UTF8_Decode(regFilter);
+    const std::wregex           w_filter(regFilter.empty() ? L".*" : utf_filter, std::regex::ECMAScript | std::regex::optimize);
     ZeroMemory(&file_info, sizeof(WIN32_FIND_DATAW));
     auto h_File = FindFirstFileW(file_pattern.c_str(), &file_info);
     MakeScopeGuard([&] { if (h_File && h_File != INVALID_HANDLE_VALUE) { FindClose(h_File); h_File = nullptr; }});
@@ -319,7 +355,7 @@ const std::list<fs::path> enumDir(const fs::path &Path, const std::string& regFi
     }
     do
     {
-        if (!regFilter.empty() && !std::regex_match(file_info.cFileName, std::wregex(utf_filter)))
+        if (!regFilter.empty() && !std::regex_match(file_info.cFileName, w_filter))
         {
             continue;
         }
@@ -328,5 +364,56 @@ const std::list<fs::path> enumDir(const fs::path &Path, const std::string& regFi
     return result;
 }
 
+static int64_t unixNanoseconds(const FILETIME &time)
+{
+    // FILETIME counts 100ns ticks since 1601-01-01
+    const uint64_t ticks = (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    return (static_cast<int64_t>(ticks) - 116444736000000000LL) * 100;
+}
+
+LIB_EXPORT
+bool getMetadata(const fs::path &Path, fs::metadata &result, const uint32_t fields, const bool followLinks)
+{
+    const auto  expanded_path = expandPath(Path);
+    const DWORD flags         = FILE_FLAG_BACKUP_SEMANTICS | (followLinks ? 0 : FILE_FLAG_OPEN_REPARSE_POINT);
+    BY_HANDLE_FILE_INFORMATION  file_info;
+    FILE_BASIC_INFO             basic_info;
+    result = {};
+    ZeroMemory(&file_info, sizeof(BY_HANDLE_FILE_INFORMATION));
+    ZeroMemory(&basic_info, sizeof(FILE_BASIC_INFO));
+
+    auto h_File = CreateFileW(expanded_path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (!h_File || h_File == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    MakeScopeGuard([&] {if (h_File && h_File != INVALID_HANDLE_VALUE) { CloseHandle(h_File); h_File = nullptr; }});
+    if (!GetFileInformationByHandle(h_File, &file_info))
+    {
+        return false;
+    }
+    const bool is_dir  = (file_info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    const bool is_link = !followLinks && (file_info.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+    result.Type         = is_link ? fs::entry_type::symlink : is_dir ? fs::entry_type::directory : fs::entry_type::file;
+    result.Mode         = ((file_info.dwFileAttributes & FILE_ATTRIBUTE_READONLY) ? 0444 : 0666) | (is_dir ? 0111 : 0);
+    result.Links        = file_info.nNumberOfLinks;
+    result.Device       = file_info.dwVolumeSerialNumber;
+    result.Inode        = (static_cast<uint64_t>(file_info.nFileIndexHigh) << 32) | file_info.nFileIndexLow;
+    result.Size         = (static_cast<uint64_t>(file_info.nFileSizeHigh) << 32) | file_info.nFileSizeLow;
+    result.AccessTime   = unixNanoseconds(file_info.ftLastAccessTime);
+    result.ModifyTime   = unixNanoseconds(file_info.ftLastWriteTime);
+    result.BirthTime    = unixNanoseconds(file_info.ftCreationTime);
+    result.Attributes   = file_info.dwFileAttributes;
+    result.Valid        = fields & ~(fs::metadata_field::owner | fs::metadata_field::ctime);
+    // Change time is only exposed through FILE_BASIC_INFO
+    if ((fields & fs::metadata_field::ctime) &&
+        GetFileInformationByHandleEx(h_File, FILE_INFO_BY_HANDLE_CLASS::FileBasicInfo, &basic_info, sizeof(FILE_BASIC_INFO)))
+    {
+        result.ChangeTime = (basic_info.ChangeTime.QuadPart - 116444736000000000LL) * 100;
+        result.Valid     |= fs::metadata_field::ctime;
+    }
+    return true;
+}
+
 }
 #endif
\ No newline at end of file
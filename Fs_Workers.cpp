@@ -0,0 +1,135 @@
+#include "FsLib.h"
+#include "Fs_Internal.h"
+
+#if !defined PLATFORM_WIN
+namespace
+{
+    thread_local const void *current_pool   = nullptr;
+    thread_local unsigned    current_worker = 0;
+}
+
+namespace fs::internal
+{
+    WorkStealingPool::WorkStealingPool(const unsigned threads)
+    {
+        const unsigned count = threadCount(threads);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            m_queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < count; ++i)
+        {
+            m_threads.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto &it : m_threads)
+        {
+            it.join();
+        }
+    }
+
+    void WorkStealingPool::spawn(task work)
+    {
+        const unsigned target = current_pool == this ? current_worker
+                                                     : m_next.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        {
+            // Counted under m_lock so a worker about to sleep can't miss it
+            std::lock_guard<std::mutex> lock(m_lock);
+            ++m_pending;
+            m_queued.fetch_add(1, std::memory_order_release);
+            std::lock_guard<std::mutex> queue_lock(m_queues[target]->Lock);
+            m_queues[target]->Tasks.push_back(std::move(work));
+        }
+        m_wake.notify_one();
+    }
+
+    void WorkStealingPool::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_idle.wait(lock, [&] { return m_pending == 0; });
+    }
+
+    void WorkStealingPool::cancel()
+    {
+        std::size_t dropped = 0;
+        for (auto &queue : m_queues)
+        {
+            std::deque<task> tasks;
+            {
+                std::lock_guard<std::mutex> lock(queue->Lock);
+                tasks.swap(queue->Tasks);
+            }
+            dropped += tasks.size();
+        }
+        m_queued.fetch_sub(dropped, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_pending -= dropped;
+        if (m_pending == 0)
+        {
+            m_idle.notify_all();
+        }
+    }
+
+    bool WorkStealingPool::take(const unsigned self, task &work)
+    {
+        {
+            auto &own = *m_queues[self];
+            std::lock_guard<std::mutex> lock(own.Lock);
+            if (!own.Tasks.empty())
+            {
+                work = std::move(own.Tasks.back());
+                own.Tasks.pop_back();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < m_queues.size(); ++i)
+        {
+            auto &victim = *m_queues[(self + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.Lock);
+            if (!victim.Tasks.empty())
+            {
+                work = std::move(victim.Tasks.front());
+                victim.Tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkStealingPool::workerLoop(const unsigned self)
+    {
+        current_pool   = this;
+        current_worker = self;
+        for (;;)
+        {
+            task work;
+            if (take(self, work))
+            {
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                work();
+                work = nullptr;
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (--m_pending == 0)
+                {
+                    m_idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_wake.wait(lock, [&] { return m_stop || m_queued.load(std::memory_order_acquire) != 0; });
+            if (m_stop)
+            {
+                return;
+            }
+        }
+    }
+}
+#endif